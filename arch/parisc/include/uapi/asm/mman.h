@@ -61,6 +61,10 @@
 #define MADV_WIPEONFORK 71		/* Zero memory on fork, child only */
 #define MADV_KEEPONFORK 72		/* Undo MADV_WIPEONFORK */
 
+#define MADV_TIER_FAST 73		/* Keep these pages on fast nodes */
+#define MADV_TIER_SLOW 74		/* Place these pages on slow nodes */
+#define MADV_TIER_NONE 75		/* Clear MADV_TIER_FAST/SLOW */
+
 #define MADV_HWPOISON     100		/* poison a page for testing */
 #define MADV_SOFT_OFFLINE 101		/* soft offline page for testing */
 
@@ -228,6 +228,32 @@ static ssize_t node_read_distance(struct device *dev,
 }
 static DEVICE_ATTR(distance, S_IRUGO, node_read_distance, NULL);
 
+static ssize_t node_read_promote_reserve(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	pg_data_t *pgdat = NODE_DATA(dev->id);
+
+	return sprintf(buf, "%lu\n",
+		       READ_ONCE(pgdat->promote_reserve) << (PAGE_SHIFT - 10));
+}
+
+static ssize_t node_write_promote_reserve(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	unsigned long kbytes;
+	int err;
+
+	err = kstrtoul(buf, 10, &kbytes);
+	if (err)
+		return err;
+
+	set_promote_reserve(dev->id, kbytes >> (PAGE_SHIFT - 10));
+	return count;
+}
+static DEVICE_ATTR(promote_reserve_kbytes, S_IRUGO | S_IWUSR,
+		   node_read_promote_reserve, node_write_promote_reserve);
+
 static struct attribute *node_dev_attrs[] = {
 	&dev_attr_cpumap.attr,
 	&dev_attr_cpulist.attr,
@@ -235,6 +261,7 @@ static struct attribute *node_dev_attrs[] = {
 	&dev_attr_numastat.attr,
 	&dev_attr_distance.attr,
 	&dev_attr_vmstat.attr,
+	&dev_attr_promote_reserve_kbytes.attr,
 	NULL
 };
 ATTRIBUTE_GROUPS(node_dev);
@@ -312,7 +312,9 @@ static int proc_pid_page_migration_stats(struct seq_file *m, struct pid_namespac
 		var.nr_exchange_base_pages, \
 		var.nr_exchange_huge_pages, \
 		SHOW_PAGE_MIGRATION_COUNTERS(var.f2s), \
-		SHOW_PAGE_MIGRATION_COUNTERS(var.s2f)
+		SHOW_PAGE_MIGRATION_COUNTERS(var.s2f), \
+		var.nr_swap_tier_pages, \
+		var.nr_pingpong_suppressed
 
 
 	seq_printf(m,
@@ -326,7 +328,9 @@ static int proc_pid_page_migration_stats(struct seq_file *m, struct pid_namespac
 		"Fast2SlowHugePageMigrations_nr_base_pages %lu\n"
 		"Slow2Fast_nr_migrations %lu\n"
 		"Slow2FastBasePageMigrations_nr_base_pages %lu\n"
-		"Slow2FastHugePageMigrations_nr_base_pages %lu\n",
+		"Slow2FastHugePageMigrations_nr_base_pages %lu\n"
+		"Slow2Swap_nr_base_pages %lu\n"
+		"PingPongSuppressed_nr_base_pages %lu\n",
 
 		SHOW_PAGE_MIGRATION_STATS(stats)
 
@@ -359,7 +363,9 @@ static int proc_pid_child_stats(struct seq_file *m, struct pid_namespace *ns,
 			"Fast2SlowHugePageMigrations_nr_base_pages %lu\n"
 			"Slow2Fast_nr_migrations %lu\n"
 			"Slow2FastBasePageMigrations_nr_base_pages %lu\n"
-			"Slow2FastHugePageMigrations_nr_base_pages %lu\n",
+			"Slow2FastHugePageMigrations_nr_base_pages %lu\n"
+			"Slow2Swap_nr_base_pages %lu\n"
+			"PingPongSuppressed_nr_base_pages %lu\n",
 
 			SHOW_PAGE_MIGRATION_STATS(child_stats)
 
@@ -3137,6 +3143,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("maps",       S_IRUGO, proc_pid_maps_operations),
 #ifdef CONFIG_NUMA
 	REG("numa_maps",  S_IRUGO, proc_pid_numa_maps_operations),
+	REG("numa_stat",  S_IRUSR, proc_pid_numa_stat_operations),
 #endif
 	REG("mem",        S_IRUSR|S_IWUSR, proc_mem_operations),
 	LNK("cwd",        proc_cwd_link),
@@ -3150,6 +3157,7 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
 	REG("smaps_rollup", S_IRUGO, proc_pid_smaps_rollup_operations),
 	REG("pagemap",    S_IRUSR, proc_pagemap_operations),
+	REG("hotmap",     S_IRUSR, proc_hotmap_operations),
 #endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
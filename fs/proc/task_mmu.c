@@ -683,6 +683,10 @@ static void show_smap_vma_flags(struct seq_file *m, struct vm_area_struct *vma)
 		[ilog2(VM_PKEY_BIT1)]	= "",
 		[ilog2(VM_PKEY_BIT2)]	= "",
 		[ilog2(VM_PKEY_BIT3)]	= "",
+#endif
+#ifdef CONFIG_64BIT
+		[ilog2(VM_TIER_FAST)]	= "tf",
+		[ilog2(VM_TIER_SLOW)]	= "ts",
 #endif
 	};
 	size_t i;
@@ -1579,6 +1583,219 @@ const struct file_operations proc_pagemap_operations = {
 	.open		= pagemap_open,
 	.release	= pagemap_release,
 };
+
+/*
+ * /proc/pid/hotmap - harvest and clear access information in one walk
+ *
+ * Reading returns an array of struct hotmap_entry, one for every present
+ * page, or one per PMD for a THP mapped by a PMD. The young and dirty
+ * state reported for a page is cleared as the page is reported, which
+ * makes a read equivalent to reading pagemap and then writing 1 and 4
+ * to clear_refs. Dirty means the pte is soft-dirty, that is written since
+ * the last harvest. Unlike clear_refs, the VM_SOFTDIRTY flag of a VMA is
+ * neither reported nor cleared: that would need mmap_sem for write. The
+ * file position is the virtual address to resume from.
+ */
+struct hotmap_entry {
+	u64 addr;
+	u64 pfn;		/* zero without CAP_SYS_ADMIN, like pagemap */
+	u32 node;
+	u32 flags;
+};
+
+#define HM_YOUNG		BIT(0)
+#define HM_DIRTY		BIT(1)
+#define HM_THP			BIT(2)
+
+#define HM_ENTRY_BYTES		sizeof(struct hotmap_entry)
+#define HM_END_OF_BUFFER	1
+
+struct hotmapread {
+	int pos, len;		/* units: HM_ENTRY_BYTES, not bytes */
+	struct hotmap_entry *buffer;
+	unsigned long resume;	/* first address not reported */
+	bool show_pfn;
+};
+
+static void add_to_hotmap(struct hotmapread *hm, unsigned long addr,
+			  struct page *page, u32 flags)
+{
+	struct hotmap_entry *he = &hm->buffer[hm->pos++];
+
+	he->addr = addr;
+	he->pfn = hm->show_pfn ? page_to_pfn(page) : 0;
+	he->node = page_to_nid(page);
+	he->flags = flags;
+}
+
+static int hotmap_pmd_range(pmd_t *pmdp, unsigned long addr,
+			    unsigned long end, struct mm_walk *walk)
+{
+	struct hotmapread *hm = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	spinlock_t *ptl;
+	pte_t *orig_pte, *pte;
+	struct page *page;
+	u32 flags;
+	int err = 0;
+
+	ptl = pmd_trans_huge_lock(pmdp, vma);
+	if (ptl) {
+		if (!pmd_present(*pmdp))
+			goto out;
+		if (hm->pos >= hm->len) {
+			hm->resume = addr;
+			err = HM_END_OF_BUFFER;
+			goto out;
+		}
+
+		page = pmd_page(*pmdp);
+		flags = HM_THP;
+		if (pmdp_test_and_clear_young(vma, addr, pmdp) |
+		    test_and_clear_page_young(page) |
+		    TestClearPageReferenced(page))
+			flags |= HM_YOUNG;
+		if (pmd_soft_dirty(*pmdp))
+			flags |= HM_DIRTY;
+		clear_soft_dirty_pmd(vma, addr, pmdp);
+		add_to_hotmap(hm, addr & HPAGE_PMD_MASK, page, flags);
+out:
+		spin_unlock(ptl);
+		return err;
+	}
+
+	if (pmd_trans_unstable(pmdp))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmdp, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+
+		if (!pte_present(ptent))
+			continue;
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+		if (hm->pos >= hm->len) {
+			hm->resume = addr;
+			err = HM_END_OF_BUFFER;
+			break;
+		}
+
+		flags = 0;
+		if (ptep_test_and_clear_young(vma, addr, pte) |
+		    test_and_clear_page_young(page) |
+		    TestClearPageReferenced(page))
+			flags |= HM_YOUNG;
+		if (pte_soft_dirty(ptent))
+			flags |= HM_DIRTY;
+		clear_soft_dirty(vma, addr, pte);
+		add_to_hotmap(hm, addr, page, flags);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+
+	cond_resched();
+
+	return err;
+}
+
+static int hotmap_test_walk(unsigned long start, unsigned long end,
+			    struct mm_walk *walk)
+{
+	return !!(walk->vma->vm_flags & VM_PFNMAP);
+}
+
+static ssize_t hotmap_read(struct file *file, char __user *buf,
+			   size_t count, loff_t *ppos)
+{
+	struct mm_struct *mm = file->private_data;
+	struct hotmapread hm;
+	struct mm_walk hotmap_walk = {};
+	unsigned long start_vaddr;
+	unsigned long end_vaddr;
+	int ret = 0, copied = 0;
+
+	if (!mm || !mmget_not_zero(mm))
+		goto out;
+
+	ret = -EINVAL;
+	/* reads must be made of whole entries */
+	if (count % HM_ENTRY_BYTES)
+		goto out_mm;
+
+	ret = 0;
+	if (!count)
+		goto out_mm;
+
+	/* do not disclose physical addresses: attack vector */
+	hm.show_pfn = file_ns_capable(file, &init_user_ns, CAP_SYS_ADMIN);
+
+	hm.len = min_t(size_t, count / HM_ENTRY_BYTES,
+		       PAGEMAP_WALK_SIZE >> PAGE_SHIFT);
+	hm.buffer = kmalloc_array(hm.len, HM_ENTRY_BYTES, GFP_KERNEL);
+	ret = -ENOMEM;
+	if (!hm.buffer)
+		goto out_mm;
+
+	hotmap_walk.pmd_entry = hotmap_pmd_range;
+	hotmap_walk.test_walk = hotmap_test_walk;
+	hotmap_walk.mm = mm;
+	hotmap_walk.private = &hm;
+
+	start_vaddr = *ppos;
+	end_vaddr = mm->task_size;
+	if (*ppos < 0 || *ppos > end_vaddr)
+		start_vaddr = end_vaddr;
+
+	ret = 0;
+	while (hm.len && start_vaddr < end_vaddr) {
+		unsigned long end;
+		int len;
+
+		hm.pos = 0;
+		end = (start_vaddr + PAGEMAP_WALK_SIZE) & PAGEMAP_WALK_MASK;
+		/* overflow ? */
+		if (end < start_vaddr || end > end_vaddr)
+			end = end_vaddr;
+		down_read(&mm->mmap_sem);
+		/* Secondary MMUs must see the soft-dirty write protection. */
+		mmu_notifier_invalidate_range_start(mm, start_vaddr, end);
+		ret = walk_page_range(start_vaddr, end, &hotmap_walk);
+		mmu_notifier_invalidate_range_end(mm, start_vaddr, end);
+		/* Like clear_refs, flush the cleared ptes before unlocking. */
+		if (hm.pos)
+			flush_tlb_mm(mm);
+		up_read(&mm->mmap_sem);
+		start_vaddr = ret == HM_END_OF_BUFFER ? hm.resume : end;
+
+		len = hm.pos * HM_ENTRY_BYTES;
+		if (copy_to_user(buf, hm.buffer, len)) {
+			ret = -EFAULT;
+			break;
+		}
+		copied += len;
+		buf += len;
+		count -= len;
+		hm.len = min_t(size_t, hm.len, count / HM_ENTRY_BYTES);
+	}
+
+	*ppos = start_vaddr;
+	if (!ret || ret == HM_END_OF_BUFFER)
+		ret = copied;
+
+	kfree(hm.buffer);
+out_mm:
+	mmput(mm);
+out:
+	return ret;
+}
+
+const struct file_operations proc_hotmap_operations = {
+	.llseek		= mem_lseek, /* borrow this */
+	.read		= hotmap_read,
+	.open		= pagemap_open,
+	.release	= pagemap_release,
+};
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
 #ifdef CONFIG_NUMA
@@ -1881,4 +2098,238 @@ const struct file_operations proc_tid_numa_maps_operations = {
 	.llseek		= seq_lseek,
 	.release	= proc_map_release,
 };
+
+/*
+ * /proc/pid/numa_stat - binary per-VMA, per-node residency
+ *
+ * Each read returns an array of struct numa_stat_entry, one for every
+ * node that has pages of a VMA resident or under migration. The file
+ * position is the virtual address the walk resumes from, so a reader
+ * seeks to 0 and reads until EOF. Only whole VMAs are returned, which
+ * means the buffer must hold at least nr_node_ids entries. Unlike
+ * numa_maps, mmap_sem is only held while a single VMA is walked.
+ */
+struct numa_stat_entry {
+	u64 start;		/* VMA range covered by this entry */
+	u64 end;
+	u32 node;
+	u32 reserved;
+	u64 pages;		/* resident pages, THP subpages included */
+	u64 thp;		/* pages mapped by a PMD */
+	u64 active;		/* pages on the active or unevictable LRU */
+	u64 young;		/* pages referenced since the last clear_refs */
+	u64 migrating;		/* pages replaced by a migration entry */
+};
+
+struct numa_stat_node {
+	u64 pages;
+	u64 thp;
+	u64 active;
+	u64 young;
+	u64 migrating;
+};
+
+static void numa_stat_account(struct page *page, struct numa_stat_node *ns,
+			      bool young, unsigned long nr_pages)
+{
+	ns += page_to_nid(page);
+	ns->pages += nr_pages;
+	if (PageActive(page) || PageUnevictable(page))
+		ns->active += nr_pages;
+	if (young || page_is_young(page) || PageReferenced(page))
+		ns->young += nr_pages;
+}
+
+static void numa_stat_account_migration(swp_entry_t entry,
+					struct numa_stat_node *ns,
+					unsigned long nr_pages)
+{
+	struct page *page;
+
+	if (!is_migration_entry(entry))
+		return;
+	page = migration_entry_to_page(entry);
+	if (page)
+		ns[page_to_nid(page)].migrating += nr_pages;
+}
+
+static int numa_stat_pte_range(pmd_t *pmd, unsigned long addr,
+		unsigned long end, struct mm_walk *walk)
+{
+	struct numa_stat_node *ns = walk->private;
+	struct vm_area_struct *vma = walk->vma;
+	spinlock_t *ptl;
+	pte_t *orig_pte;
+	pte_t *pte;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	ptl = pmd_trans_huge_lock(pmd, vma);
+	if (ptl) {
+		struct page *page;
+
+		if (is_pmd_migration_entry(*pmd)) {
+			numa_stat_account_migration(pmd_to_swp_entry(*pmd), ns,
+						    HPAGE_PMD_NR);
+		} else {
+			page = can_gather_numa_stats_pmd(*pmd, vma, addr);
+			if (page) {
+				numa_stat_account(page, ns, pmd_young(*pmd),
+						  HPAGE_PMD_NR);
+				ns[page_to_nid(page)].thp += HPAGE_PMD_NR;
+			}
+		}
+		spin_unlock(ptl);
+		return 0;
+	}
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+#endif
+	orig_pte = pte = pte_offset_map_lock(walk->mm, pmd, addr, &ptl);
+	do {
+		struct page *page;
+
+		if (is_swap_pte(*pte)) {
+			numa_stat_account_migration(pte_to_swp_entry(*pte),
+						    ns, 1);
+			continue;
+		}
+		page = can_gather_numa_stats(*pte, vma, addr);
+		if (page)
+			numa_stat_account(page, ns, pte_young(*pte), 1);
+	} while (pte++, addr += PAGE_SIZE, addr != end);
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+	return 0;
+}
+
+#ifdef CONFIG_HUGETLB_PAGE
+static int numa_stat_hugetlb_range(pte_t *pte, unsigned long hmask,
+		unsigned long addr, unsigned long end, struct mm_walk *walk)
+{
+	pte_t huge_pte = huge_ptep_get(pte);
+
+	if (!pte_present(huge_pte))
+		return 0;
+
+	numa_stat_account(pte_page(huge_pte), walk->private,
+			  pte_young(huge_pte), (end - addr) >> PAGE_SHIFT);
+	return 0;
+}
+#else
+#define numa_stat_hugetlb_range	NULL
+#endif
+
+static ssize_t numa_stat_read(struct file *file, char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct mm_struct *mm = file->private_data;
+	struct mm_walk numa_stat_walk = {
+		.pmd_entry = numa_stat_pte_range,
+		.hugetlb_entry = numa_stat_hugetlb_range,
+		.mm = mm,
+	};
+	struct numa_stat_node *ns;
+	unsigned long addr = *ppos;
+	ssize_t copied = 0;
+	int ret = 0;
+
+	if (!mm || !mmget_not_zero(mm))
+		return 0;
+
+	ret = -EINVAL;
+	if (count % sizeof(struct numa_stat_entry) ||
+	    count < nr_node_ids * sizeof(struct numa_stat_entry))
+		goto out_mm;
+
+	ret = -ENOMEM;
+	ns = kcalloc(nr_node_ids, sizeof(*ns), GFP_KERNEL);
+	if (!ns)
+		goto out_mm;
+	numa_stat_walk.private = ns;
+
+	ret = 0;
+	while (!fatal_signal_pending(current)) {
+		struct numa_stat_entry entry = {};
+		struct vm_area_struct *vma;
+		unsigned long start, end;
+		int nid, nr = 0;
+
+		down_read(&mm->mmap_sem);
+		vma = find_vma(mm, addr);
+		if (!vma) {
+			up_read(&mm->mmap_sem);
+			break;
+		}
+		start = max(addr, vma->vm_start);
+		end = vma->vm_end;
+		memset(ns, 0, nr_node_ids * sizeof(*ns));
+		walk_page_range(start, end, &numa_stat_walk);
+		up_read(&mm->mmap_sem);
+
+		for_each_node_state(nid, N_MEMORY)
+			if (ns[nid].pages || ns[nid].migrating)
+				nr++;
+		/* The next VMA does not fit; the reader resumes from it. */
+		if (nr * sizeof(entry) > count)
+			break;
+
+		entry.start = start;
+		entry.end = end;
+		for_each_node_state(nid, N_MEMORY) {
+			if (!ns[nid].pages && !ns[nid].migrating)
+				continue;
+			entry.node = nid;
+			entry.pages = ns[nid].pages;
+			entry.thp = ns[nid].thp;
+			entry.active = ns[nid].active;
+			entry.young = ns[nid].young;
+			entry.migrating = ns[nid].migrating;
+			if (copy_to_user(buf, &entry, sizeof(entry))) {
+				ret = -EFAULT;
+				goto out_free;
+			}
+			buf += sizeof(entry);
+			count -= sizeof(entry);
+			copied += sizeof(entry);
+		}
+		addr = end;
+		cond_resched();
+	}
+	*ppos = addr;
+	ret = copied;
+
+out_free:
+	kfree(ns);
+out_mm:
+	mmput(mm);
+	return ret;
+}
+
+static int numa_stat_open(struct inode *inode, struct file *file)
+{
+	struct mm_struct *mm;
+
+	mm = proc_mem_open(inode, PTRACE_MODE_READ);
+	if (IS_ERR(mm))
+		return PTR_ERR(mm);
+	file->private_data = mm;
+	return 0;
+}
+
+static int numa_stat_release(struct inode *inode, struct file *file)
+{
+	struct mm_struct *mm = file->private_data;
+
+	if (mm)
+		mmdrop(mm);
+	return 0;
+}
+
+const struct file_operations proc_pid_numa_stat_operations = {
+	.llseek		= mem_lseek, /* borrow this */
+	.read		= numa_stat_read,
+	.open		= numa_stat_open,
+	.release	= numa_stat_release,
+};
 #endif /* CONFIG_NUMA */
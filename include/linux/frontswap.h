@@ -7,9 +7,14 @@
 #include <linux/bitops.h>
 #include <linux/jump_label.h>
 
+/* the most pages a single store_batch call is handed */
+#define FRONTSWAP_BATCH_MAX	16
+
 struct frontswap_ops {
 	void (*init)(unsigned); /* this swap type was just swapon'ed */
 	int (*store)(unsigned, pgoff_t, struct page *); /* store a page */
+	/* store pages, optional */
+	void (*store_batch)(unsigned, pgoff_t *, struct page **, int, int *);
 	int (*load)(unsigned, pgoff_t, struct page *); /* load a page */
 	void (*invalidate_page)(unsigned, pgoff_t); /* page no longer needed */
 	void (*invalidate_area)(unsigned); /* swap type just swapoff'ed */
@@ -26,6 +31,7 @@ extern void frontswap_tmem_exclusive_gets(bool);
 extern bool __frontswap_test(struct swap_info_struct *, pgoff_t);
 extern void __frontswap_init(unsigned type, unsigned long *map);
 extern int __frontswap_store(struct page *page);
+extern void __frontswap_store_batch(struct page **pages, int nr, int *rets);
 extern int __frontswap_load(struct page *page);
 extern void __frontswap_invalidate_page(unsigned, pgoff_t);
 extern void __frontswap_invalidate_area(unsigned);
@@ -85,6 +91,20 @@ static inline int frontswap_store(struct page *page)
 	return -1;
 }
 
+static inline void frontswap_store_batch(struct page **pages, int nr,
+					 int *rets)
+{
+	int i;
+
+	if (frontswap_enabled()) {
+		__frontswap_store_batch(pages, nr, rets);
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		rets[i] = -1;
+}
+
 static inline int frontswap_load(struct page *page)
 {
 	if (frontswap_enabled())
@@ -65,6 +65,7 @@ struct page *ksm_might_need_to_copy(struct page *page,
 void rmap_walk_ksm(struct page *page, struct rmap_walk_control *rwc);
 void ksm_migrate_page(struct page *newpage, struct page *oldpage);
 void ksm_exchange_page(struct page *to_page, struct page *from_page);
+bool ksm_page_hot(struct page *page);
 
 #else  /* !CONFIG_KSM */
 
@@ -108,6 +109,11 @@ static inline void ksm_exchange_page(struct page *to_page,
 				struct page *from_page)
 {
 }
+
+static inline bool ksm_page_hot(struct page *page)
+{
+	return false;
+}
 #endif /* CONFIG_MMU */
 #endif /* !CONFIG_KSM */
 
@@ -197,6 +197,10 @@ struct mem_cgroup {
 	int		under_oom;
 
 	int	swappiness;
+	/* mm_manage may demote slow-node overflow to swap */
+	bool	swap_tier;
+	/* node for readahead and use-once page cache, or NUMA_NO_NODE */
+	int	page_cache_node;
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
@@ -710,6 +714,13 @@ static inline unsigned long memcg_max_size_node(struct mem_cgroup *memcg, int ni
 	return memcg->nodeinfo[nid]->max_nr_base_pages;
 }
 
+static inline bool memcg_swap_tier_enabled(struct mem_cgroup *memcg)
+{
+	return READ_ONCE(memcg->swap_tier);
+}
+
+int mem_cgroup_page_cache_node(struct task_struct *p);
+
 #else /* CONFIG_MEMCG */
 
 #define MEM_CGROUP_ID_SHIFT	0
@@ -1221,6 +1232,16 @@ static inline unsigned long memcg_max_size_node(struct mem_cgroup *memcg, int ni
 	return 0;
 }
 
+static inline bool memcg_swap_tier_enabled(struct mem_cgroup *memcg)
+{
+	return false;
+}
+
+static inline int mem_cgroup_page_cache_node(struct task_struct *p)
+{
+	return NUMA_NO_NODE;
+}
+
 #endif /* CONFIG_MEMCG && !CONFIG_SLOB */
 
 
@@ -202,6 +202,8 @@ static inline bool vma_migratable(struct vm_area_struct *vma)
 	return true;
 }
 
+extern bool mpol_node_allowed(struct vm_area_struct *vma, unsigned long addr,
+			      int nid);
 extern int mpol_misplaced(struct page *, struct vm_area_struct *, unsigned long);
 extern void mpol_put_task_policy(struct task_struct *);
 
@@ -299,6 +301,12 @@ static inline int mpol_parse_str(char *str, struct mempolicy **mpol)
 }
 #endif
 
+static inline bool mpol_node_allowed(struct vm_area_struct *vma,
+				     unsigned long addr, int nid)
+{
+	return true;
+}
+
 static inline int mpol_misplaced(struct page *page, struct vm_area_struct *vma,
 				 unsigned long address)
 {
@@ -25,6 +25,7 @@ enum migrate_reason {
 	MR_MEMPOLICY_MBIND,
 	MR_NUMA_MISPLACED,
 	MR_CMA,
+	MR_DEMOTION,
 	MR_TYPES
 };
 
@@ -135,6 +136,9 @@ static inline void __ClearPageMovable(struct page *page)
 extern bool pmd_trans_migrating(pmd_t pmd);
 extern int migrate_misplaced_page(struct page *page,
 				  struct vm_area_struct *vma, int node);
+extern int queue_misplaced_page(struct page *page,
+				struct vm_area_struct *vma, int node,
+				struct task_struct *p);
 #else
 static inline bool pmd_trans_migrating(pmd_t pmd)
 {
@@ -145,6 +149,12 @@ static inline int migrate_misplaced_page(struct page *page,
 {
 	return -EAGAIN; /* can't migrate now */
 }
+static inline int queue_misplaced_page(struct page *page,
+				       struct vm_area_struct *vma, int node,
+				       struct task_struct *p)
+{
+	return -EAGAIN; /* can't migrate now */
+}
 #endif /* CONFIG_NUMA_BALANCING */
 
 #if defined(CONFIG_NUMA_BALANCING) && defined(CONFIG_TRANSPARENT_HUGEPAGE)
@@ -250,6 +250,17 @@ extern unsigned int kobjsize(const void *objp);
 # define VM_GROWSUP	VM_NONE
 #endif
 
+#ifdef CONFIG_64BIT
+# define VM_TIER_FAST_BIT	37
+# define VM_TIER_SLOW_BIT	38
+# define VM_TIER_FAST	BIT(VM_TIER_FAST_BIT)	/* MADV_TIER_FAST: never demote */
+# define VM_TIER_SLOW	BIT(VM_TIER_SLOW_BIT)	/* MADV_TIER_SLOW: never promote */
+#else
+# define VM_TIER_FAST	VM_NONE
+# define VM_TIER_SLOW	VM_NONE
+#endif
+#define VM_TIER_MASK	(VM_TIER_FAST | VM_TIER_SLOW)
+
 /* Bits set in the VMA until the stack is in its final location */
 #define VM_STACK_INCOMPLETE_SETUP	(VM_RAND_READ | VM_SEQ_READ)
 
@@ -1471,6 +1482,12 @@ extern unsigned long move_page_tables(struct vm_area_struct *vma,
 		unsigned long old_addr, struct vm_area_struct *new_vma,
 		unsigned long new_addr, unsigned long len,
 		bool need_rmap_locks);
+/*
+ * prot_numa value for change_protection(): only mark ptes of pages that are
+ * not on the local node, i.e. on a slower tier from the scanning task's view.
+ */
+#define PROT_NUMA_TIER	2
+
 extern unsigned long change_protection(struct vm_area_struct *vma, unsigned long start,
 			      unsigned long end, pgprot_t newprot,
 			      int dirty_accountable, int prot_numa);
@@ -2020,6 +2037,7 @@ extern void set_dma_reserve(unsigned long new_dma_reserve);
 extern void memmap_init_zone(unsigned long, int, unsigned long,
 				unsigned long, enum memmap_context);
 extern void setup_per_zone_wmarks(void);
+extern void set_promote_reserve(int nid, unsigned long nr_pages);
 extern int __meminit init_per_zone_wmark_min(void);
 extern void mem_init(void);
 extern void __init mmap_init(void);
@@ -2345,6 +2363,8 @@ static inline void vma_set_page_prot(struct vm_area_struct *vma)
 #ifdef CONFIG_NUMA_BALANCING
 unsigned long change_prot_numa(struct vm_area_struct *vma,
 			unsigned long start, unsigned long end);
+unsigned long change_prot_numa_tier(struct vm_area_struct *vma,
+			unsigned long start, unsigned long end);
 #endif
 
 struct vm_area_struct *find_extend_vma(struct mm_struct *, unsigned long addr);
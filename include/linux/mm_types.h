@@ -335,6 +335,14 @@ struct vm_area_struct {
 #endif
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
+#endif
+#ifdef CONFIG_NUMA_BALANCING
+	/*
+	 * Slow-tier resident pages marked for hinting faults by the tier
+	 * aware scan, during the mm->numa_scan_seq pass in numa_scan_seq.
+	 */
+	unsigned long numa_scan_slow;
+	int numa_scan_seq;
 #endif
 	struct vm_userfaultfd_ctx vm_userfaultfd_ctx;
 } __randomize_layout;
@@ -362,6 +362,13 @@ struct zone {
 	/* zone watermarks, access with *_wmark_pages(zone) macros */
 	unsigned long watermark[NR_WMARK];
 
+	/*
+	 * This zone's share of the node's promotion reserve. Only
+	 * allocations made for promotion may take free pages below
+	 * watermark + promote_reserve.
+	 */
+	unsigned long promote_reserve;
+
 	unsigned long nr_reserved_highatomic;
 
 	/*
@@ -661,6 +668,26 @@ typedef struct pglist_data {
 
 	int kswapd_failures;		/* Number of 'reclaimed == 0' runs */
 
+	/*
+	 * Pages kept free for promotion into this node. kswapd keeps
+	 * them free by demoting cold pages to the nearest node without
+	 * a reserve before it falls back to reclaim.
+	 */
+	unsigned long promote_reserve;
+#ifdef CONFIG_PAGE_AGE
+	/*
+	 * Demotion feedback, see update_demote_min_age(). Pages demoted from
+	 * this node that got used again shortly after, pages kswapd has
+	 * considered for demotion since the last adjustment, the page
+	 * age below which kswapd leaves pages on this node, and
+	 * page_age_stamp as of the last adjustment.
+	 */
+	atomic_long_t tier_refaults;
+	unsigned long tier_demote_scanned;
+	unsigned int demote_min_age;
+	unsigned long demote_age_stamp;
+#endif
+
 #ifdef CONFIG_COMPACTION
 	int kcompactd_max_order;
 	enum zone_type kcompactd_classzone_idx;
@@ -0,0 +1,112 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __LINUX_PAGE_AGE_H
+#define __LINUX_PAGE_AGE_H
+
+#include <linux/jump_label.h>
+
+/*
+ * A page's age is the number of consecutive aging passes that found it
+ * unreferenced, saturating at PAGE_AGE_MAX. This splits every lruvec into
+ * NR_PAGE_AGE_GENS generations, age 0 being the youngest.
+ */
+#define NR_PAGE_AGE_GENS	4
+#define PAGE_AGE_MAX		(NR_PAGE_AGE_GENS - 1)
+
+#ifdef CONFIG_PAGE_AGE
+extern struct static_key_false page_age_inited;
+extern struct page_ext_operations page_age_ops;
+extern unsigned long page_age_stamp;
+
+extern unsigned int __page_age(struct page *page);
+extern void __page_age_update(struct page *page, bool referenced);
+extern void __reset_page_age(struct page *page);
+extern void __copy_page_age(struct page *oldpage, struct page *newpage);
+extern void __exchange_page_age(struct page *page1, struct page *page2);
+extern bool __page_migrated_within(struct page *page, unsigned long window);
+extern bool __page_tier_refault(struct page *page);
+
+static inline bool page_age_enabled(void)
+{
+	return static_branch_unlikely(&page_age_inited);
+}
+/* Whether any page was ever aged, else every page is in generation 0 */
+static inline bool page_age_started(void)
+{
+	return page_age_enabled() && READ_ONCE(page_age_stamp);
+}
+
+static inline unsigned int page_age(struct page *page)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		return __page_age(page);
+	return 0;
+}
+static inline void page_age_update(struct page *page, bool referenced)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		__page_age_update(page, referenced);
+}
+static inline void reset_page_age(struct page *page)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		__reset_page_age(page);
+}
+static inline void copy_page_age(struct page *oldpage, struct page *newpage)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		__copy_page_age(oldpage, newpage);
+}
+static inline void exchange_page_age(struct page *page1, struct page *page2)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		__exchange_page_age(page1, page2);
+}
+static inline bool page_migrated_within(struct page *page,
+					unsigned long window)
+{
+	if (static_branch_unlikely(&page_age_inited) && window)
+		return __page_migrated_within(page, window);
+	return false;
+}
+static inline bool page_tier_refault(struct page *page)
+{
+	if (static_branch_unlikely(&page_age_inited))
+		return __page_tier_refault(page);
+	return false;
+}
+#else
+static inline bool page_age_enabled(void)
+{
+	return false;
+}
+static inline bool page_age_started(void)
+{
+	return false;
+}
+static inline unsigned int page_age(struct page *page)
+{
+	return 0;
+}
+static inline void page_age_update(struct page *page, bool referenced)
+{
+}
+static inline void reset_page_age(struct page *page)
+{
+}
+static inline void copy_page_age(struct page *oldpage, struct page *newpage)
+{
+}
+static inline void exchange_page_age(struct page *page1, struct page *page2)
+{
+}
+static inline bool page_migrated_within(struct page *page,
+					unsigned long window)
+{
+	return false;
+}
+static inline bool page_tier_refault(struct page *page)
+{
+	return false;
+}
+#endif /* CONFIG_PAGE_AGE */
+#endif /* __LINUX_PAGE_AGE_H */
@@ -220,11 +220,17 @@ static inline int page_cache_add_speculative(struct page *page, int count)
 
 #ifdef CONFIG_NUMA
 extern struct page *__page_cache_alloc(gfp_t gfp);
+extern struct page *__page_cache_alloc_use_once(gfp_t gfp);
 #else
 static inline struct page *__page_cache_alloc(gfp_t gfp)
 {
 	return alloc_pages(gfp, 0);
 }
+
+static inline struct page *__page_cache_alloc_use_once(gfp_t gfp)
+{
+	return alloc_pages(gfp, 0);
+}
 #endif
 
 static inline struct page *page_cache_alloc(struct address_space *x)
@@ -237,6 +243,11 @@ static inline struct page *page_cache_alloc_cold(struct address_space *x)
 	return __page_cache_alloc(mapping_gfp_mask(x)|__GFP_COLD);
 }
 
+static inline struct page *page_cache_alloc_use_once(struct address_space *x)
+{
+	return __page_cache_alloc_use_once(mapping_gfp_mask(x)|__GFP_COLD);
+}
+
 static inline gfp_t readahead_gfp_mask(struct address_space *x)
 {
 	return mapping_gfp_mask(x) |
@@ -99,6 +99,8 @@ enum ttu_flags {
 	TTU_RMAP_LOCKED		= 0x80,	/* do not grab rmap lock:
 					 * caller holds it */
 	TTU_SPLIT_FREEZE	= 0x100,		/* freeze pte under splitting thp */
+	TTU_BATCH_NOTIFY	= 0x200,	/* caller issues the mmu notifier
+					 * invalidation for the whole range */
 };
 
 #ifdef CONFIG_MMU
@@ -194,8 +196,10 @@ static inline void page_dup_rmap(struct page *page, bool compound)
  */
 int page_referenced(struct page *, int is_locked,
 			struct mem_cgroup *memcg, unsigned long *vm_flags);
+unsigned long page_tier_hint(struct page *page);
 
 bool try_to_unmap(struct page *, enum ttu_flags flags);
+void try_to_unmap_batch(struct page **pages, int nr, enum ttu_flags flags);
 
 /* Avoid racy checks */
 #define PVMW_SYNC		(1 << 0)
@@ -242,6 +246,7 @@ int page_mkclean(struct page *);
 void try_to_munlock(struct page *);
 
 void remove_migration_ptes(struct page *old, struct page *new, bool locked);
+void remove_migration_ptes_batch(struct page **old, struct page **new, int nr);
 
 /*
  * Called by memory-failure.c to kill processes.
@@ -289,6 +294,11 @@ static inline int page_referenced(struct page *page, int is_locked,
 	return 0;
 }
 
+static inline unsigned long page_tier_hint(struct page *page)
+{
+	return 0;
+}
+
 #define try_to_unmap(page, refs) false
 
 static inline int page_mkclean(struct page *page)
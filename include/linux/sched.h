@@ -93,6 +93,8 @@ struct page_migration_stats {
 	unsigned long nr_exchange_huge_pages;
 	struct page_migration_counters f2s; /* fast to slow */
 	struct page_migration_counters s2f; /* slow to fast */
+	unsigned long nr_swap_tier_pages; /* slow to swap */
+	unsigned long nr_pingpong_suppressed; /* base pages left in place */
 };
 
 /*
@@ -1061,6 +1063,14 @@ struct task_struct {
 	 * weights depending on whether they were shared or private faults
 	 */
 	unsigned long			numa_faults_locality[3];
+	/* pages promoted by hinting faults in the last scan window */
+	unsigned long			numa_faults_promoted;
+	/*
+	 * Outcome of hinting fault migrations left to the promotion worker,
+	 * folded into the fields above by the next task_numa_fault()
+	 */
+	atomic_long_t			numa_queued_migrated;
+	atomic_long_t			numa_queued_failed;
 
 	unsigned long			numa_pages_migrated;
 #endif /* CONFIG_NUMA_BALANCING */
@@ -1403,6 +1413,7 @@ extern struct pid *cad_pid;
 #define PF_KTHREAD		0x00200000	/* I am a kernel thread */
 #define PF_RANDOMIZE		0x00400000	/* Randomize virtual address space */
 #define PF_SWAPWRITE		0x00800000	/* Allowed to write to swap */
+#define PF_MEMALLOC_PROMOTE	0x01000000	/* Allocations may use the promotion reserve */
 #define PF_NO_SETAFFINITY	0x04000000	/* Userland is not allowed to meddle with cpus_allowed */
 #define PF_MCE_EARLY		0x08000000      /* Early kill for mce process policy */
 #define PF_MUTEX_TESTER		0x20000000	/* Thread belongs to the rt mutex tester */
@@ -200,6 +200,18 @@ static inline void memalloc_nofs_restore(unsigned int flags)
 	current->flags = (current->flags & ~PF_MEMALLOC_NOFS) | flags;
 }
 
+static inline unsigned int memalloc_promote_save(void)
+{
+	unsigned int flags = current->flags & PF_MEMALLOC_PROMOTE;
+	current->flags |= PF_MEMALLOC_PROMOTE;
+	return flags;
+}
+
+static inline void memalloc_promote_restore(unsigned int flags)
+{
+	current->flags = (current->flags & ~PF_MEMALLOC_PROMOTE) | flags;
+}
+
 static inline unsigned int memalloc_noreclaim_save(void)
 {
 	unsigned int flags = current->flags & PF_MEMALLOC;
@@ -17,6 +17,7 @@
 
 #ifdef CONFIG_NUMA_BALANCING
 extern void task_numa_fault(int last_node, int node, int pages, int flags);
+extern void task_numa_queued_done(struct task_struct *p, bool migrated);
 extern pid_t task_numa_group_id(struct task_struct *p);
 extern void set_numabalancing_state(bool enabled);
 extern void task_numa_free(struct task_struct *p);
@@ -27,6 +28,9 @@ static inline void task_numa_fault(int last_node, int node, int pages,
 				   int flags)
 {
 }
+static inline void task_numa_queued_done(struct task_struct *p, bool migrated)
+{
+}
 static inline pid_t task_numa_group_id(struct task_struct *p)
 {
 	return 0;
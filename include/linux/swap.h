@@ -376,7 +376,9 @@ extern void kswapd_stop(int nid);
 
 /* linux/mm/page_io.c */
 extern int swap_readpage(struct page *page, bool do_poll);
+extern int swap_readpage_contig(struct page *page, int nr);
 extern int swap_writepage(struct page *page, struct writeback_control *wbc);
+extern void swap_write_flush_plugged(void);
 extern void end_swap_bio_write(struct bio *bio);
 extern int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	bio_end_io_t end_write_func);
@@ -422,6 +424,16 @@ extern struct page *swap_readahead_detect(struct vm_fault *vmf,
 extern struct page *do_swap_page_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 					   struct vm_fault *vmf,
 					   struct vma_swap_readahead *swap_ra);
+#ifdef CONFIG_THP_SWAP
+extern struct page *swapin_huge_cluster(swp_entry_t entry,
+					struct vm_fault *vmf);
+#else
+static inline struct page *swapin_huge_cluster(swp_entry_t entry,
+					       struct vm_fault *vmf)
+{
+	return NULL;
+}
+#endif
 
 /* linux/mm/swapfile.c */
 extern atomic_long_t nr_swap_pages;
@@ -460,6 +472,7 @@ extern int free_swap_and_cache(swp_entry_t);
 extern int swap_type_of(dev_t, sector_t, struct block_device **);
 extern unsigned int count_swap_pages(int, int);
 extern sector_t map_swap_page(struct page *, struct block_device **);
+extern bool swap_page_range_contig(struct page *page, unsigned long nr);
 extern sector_t swapdev_block(int, pgoff_t);
 extern int page_swapcount(struct page *);
 extern int __swp_swapcount(swp_entry_t entry);
@@ -541,11 +554,21 @@ static inline struct page *do_swap_page_readahead(
 	return NULL;
 }
 
+static inline struct page *swapin_huge_cluster(swp_entry_t entry,
+					       struct vm_fault *vmf)
+{
+	return NULL;
+}
+
 static inline int swap_writepage(struct page *p, struct writeback_control *wbc)
 {
 	return 0;
 }
 
+static inline void swap_write_flush_plugged(void)
+{
+}
+
 static inline struct page *lookup_swap_cache(swp_entry_t swp,
 					     struct vm_area_struct *vma,
 					     unsigned long addr)
@@ -62,6 +62,10 @@
 #define MADV_WIPEONFORK 18		/* Zero memory on fork, child only */
 #define MADV_KEEPONFORK 19		/* Undo MADV_WIPEONFORK */
 
+#define MADV_TIER_FAST 20		/* Keep these pages on fast nodes */
+#define MADV_TIER_SLOW 21		/* Place these pages on slow nodes */
+#define MADV_TIER_NONE 22		/* Clear MADV_TIER_FAST/SLOW */
+
 /* compatibility flags */
 #define MAP_FILE	0
 
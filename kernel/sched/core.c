@@ -2223,6 +2223,8 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 	p->numa_scan_period = sysctl_numa_balancing_scan_delay;
 	p->numa_work.next = &p->numa_work;
 	p->numa_faults = NULL;
+	atomic_long_set(&p->numa_queued_migrated, 0);
+	atomic_long_set(&p->numa_queued_failed, 0);
 	p->last_task_numa_placement = 0;
 	p->last_sum_exec_runtime = 0;
 
@@ -1933,6 +1933,45 @@ static void numa_group_count_active_nodes(struct numa_group *numa_group)
 #define NUMA_PERIOD_SLOTS 10
 #define NUMA_PERIOD_THRESHOLD 7
 
+/*
+ * With NUMA_TIER_SCAN, hinting faults only hit slow-tier pages and the scan
+ * rate follows the fraction of them that promote a page instead: at 3 of 10
+ * the period stays the same, above it scanning speeds up, below it slows.
+ */
+#define NUMA_TIER_PERIOD_THRESHOLD 3
+
+static void update_task_scan_period_tier(struct task_struct *p)
+{
+	unsigned long faults = p->numa_faults_locality[0] +
+			       p->numa_faults_locality[1];
+	unsigned int period_slot;
+	int ratio, diff;
+
+	/*
+	 * No hinting faults means nothing hot is left on the slow tier;
+	 * failed migrations mean the fast tier is full. Scan slower.
+	 */
+	if (!faults || p->numa_faults_locality[2]) {
+		p->numa_scan_period = min(p->numa_scan_period_max,
+			p->numa_scan_period << 1);
+
+		p->mm->numa_next_scan = jiffies +
+			msecs_to_jiffies(p->numa_scan_period);
+		goto out;
+	}
+
+	period_slot = DIV_ROUND_UP(p->numa_scan_period, NUMA_PERIOD_SLOTS);
+	ratio = min_t(unsigned long, p->numa_faults_promoted, faults) *
+		NUMA_PERIOD_SLOTS / faults;
+	diff = (NUMA_TIER_PERIOD_THRESHOLD - ratio) * period_slot;
+
+	p->numa_scan_period = clamp(p->numa_scan_period + diff,
+			task_scan_min(p), task_scan_max(p));
+out:
+	memset(p->numa_faults_locality, 0, sizeof(p->numa_faults_locality));
+	p->numa_faults_promoted = 0;
+}
+
 /*
  * Increase the scan period (slow down scanning) if the majority of
  * our memory is already on our local node, or if the majority of
@@ -1949,6 +1988,11 @@ static void update_task_scan_period(struct task_struct *p,
 	unsigned long remote = p->numa_faults_locality[0];
 	unsigned long local = p->numa_faults_locality[1];
 
+	if (sched_feat(NUMA_TIER_SCAN)) {
+		update_task_scan_period_tier(p);
+		return;
+	}
+
 	/*
 	 * If there were no record hinting faults then either the task is
 	 * completely idle or all activity is areas that are not of interest
@@ -2378,6 +2422,19 @@ void task_numa_free(struct task_struct *p)
 	kfree(numa_faults);
 }
 
+/*
+ * The promotion worker migrated (or failed to migrate) a page queued by a
+ * hinting fault of @p. Only counted here; @p accounts it in its next
+ * task_numa_fault(), as if the fault had migrated the page itself.
+ */
+void task_numa_queued_done(struct task_struct *p, bool migrated)
+{
+	if (migrated)
+		atomic_long_inc(&p->numa_queued_migrated);
+	else
+		atomic_long_inc(&p->numa_queued_failed);
+}
+
 /*
  * Got a PROT_NONE fault for a page on @node.
  */
@@ -2385,6 +2442,7 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 {
 	struct task_struct *p = current;
 	bool migrated = flags & TNF_MIGRATED;
+	unsigned long nr_queued;
 	int cpu_node = task_node(current);
 	int local = !!(flags & TNF_FAULT_LOCAL);
 	struct numa_group *ng;
@@ -2408,6 +2466,7 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 
 		p->total_numa_faults = 0;
 		memset(p->numa_faults_locality, 0, sizeof(p->numa_faults_locality));
+		p->numa_faults_promoted = 0;
 	}
 
 	/*
@@ -2443,11 +2502,19 @@ void task_numa_fault(int last_cpupid, int mem_node, int pages, int flags)
 	if (time_after(jiffies, p->numa_migrate_retry))
 		numa_migrate_preferred(p);
 
-	if (migrated)
+	if (migrated) {
 		p->numa_pages_migrated += pages;
+		p->numa_faults_promoted += pages;
+	}
 	if (flags & TNF_MIGRATE_FAIL)
 		p->numa_faults_locality[2] += pages;
 
+	/* Queued migrations the promotion worker finished since last time */
+	nr_queued = atomic_long_xchg(&p->numa_queued_migrated, 0);
+	p->numa_pages_migrated += nr_queued;
+	p->numa_faults_promoted += nr_queued;
+	p->numa_faults_locality[2] += atomic_long_xchg(&p->numa_queued_failed, 0);
+
 	p->numa_faults[task_faults_idx(NUMA_MEMBUF, mem_node, priv)] += pages;
 	p->numa_faults[task_faults_idx(NUMA_CPUBUF, cpu_node, priv)] += pages;
 	p->numa_faults_locality[local] += pages;
@@ -2467,6 +2534,33 @@ static void reset_ptenuma_scan(struct task_struct *p)
 	p->mm->numa_scan_offset = 0;
 }
 
+/*
+ * Every NUMA_TIER_RESCAN passes, the tier aware scan also looks at the VMAs
+ * where the last pass found nothing on the slow tier, since pages may have
+ * been demoted there since.
+ */
+#define NUMA_TIER_RESCAN	4
+
+static bool vma_numa_tier_skip(struct vm_area_struct *vma, int seq)
+{
+	if (seq % NUMA_TIER_RESCAN == 0)
+		return false;
+	/* a pass over this VMA is in progress, or it has never been scanned */
+	if (vma->numa_scan_seq == seq || !vma->numa_scan_seq)
+		return false;
+	return !vma->numa_scan_slow;
+}
+
+static void vma_numa_tier_account(struct vm_area_struct *vma, int seq,
+				  unsigned long nr_slow)
+{
+	if (vma->numa_scan_seq != seq) {
+		vma->numa_scan_seq = seq;
+		vma->numa_scan_slow = 0;
+	}
+	vma->numa_scan_slow += nr_slow;
+}
+
 /*
  * The expensive part of numa migration is done from task_work context.
  * Triggered from task_tick_numa().
@@ -2481,6 +2575,8 @@ void task_numa_work(struct callback_head *work)
 	unsigned long start, end;
 	unsigned long nr_pte_updates = 0;
 	long pages, virtpages;
+	bool tier = sched_feat(NUMA_TIER_SCAN);
+	int seq;
 
 	SCHED_WARN_ON(p != container_of(work, struct task_struct, numa_work));
 
@@ -2539,6 +2635,7 @@ void task_numa_work(struct callback_head *work)
 		start = 0;
 		vma = mm->mmap;
 	}
+	seq = READ_ONCE(mm->numa_scan_seq);
 	for (; vma; vma = vma->vm_next) {
 		if (!vma_migratable(vma) || !vma_policy_mof(vma) ||
 			is_vm_hugetlb_page(vma) || (vma->vm_flags & VM_MIXEDMAP)) {
@@ -2562,11 +2659,21 @@ void task_numa_work(struct callback_head *work)
 		if (!(vma->vm_flags & (VM_READ | VM_EXEC | VM_WRITE)))
 			continue;
 
+		/* Nothing was on the slow tier here last time, look elsewhere */
+		if (tier && vma_numa_tier_skip(vma, seq))
+			continue;
+
 		do {
 			start = max(start, vma->vm_start);
 			end = ALIGN(start + (pages << PAGE_SHIFT), HPAGE_SIZE);
 			end = min(end, vma->vm_end);
-			nr_pte_updates = change_prot_numa(vma, start, end);
+			if (tier) {
+				nr_pte_updates = change_prot_numa_tier(vma,
+							start, end);
+				vma_numa_tier_account(vma, seq,
+						      nr_pte_updates);
+			} else
+				nr_pte_updates = change_prot_numa(vma, start, end);
 
 			/*
 			 * Try to scan sysctl_numa_balancing_size worth of
@@ -2574,9 +2681,13 @@ void task_numa_work(struct callback_head *work)
 			 * is not already pte-numa. If the VMA contains
 			 * areas that are unused or already full of prot_numa
 			 * PTEs, scan up to virtpages, to skip through those
-			 * areas faster.
+			 * areas faster. The tier aware scan only charges the
+			 * slow-tier pages it marked, so ranges that already
+			 * live on the fast tier are skipped through as well.
 			 */
-			if (nr_pte_updates)
+			if (tier)
+				pages -= nr_pte_updates;
+			else if (nr_pte_updates)
 				pages -= (end - start) >> PAGE_SHIFT;
 			virtpages -= (end - start) >> PAGE_SHIFT;
 
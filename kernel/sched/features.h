@@ -82,6 +82,13 @@ SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
 SCHED_FEAT(ATTACH_AGE_LOAD, true)
 
+/*
+ * Tier aware NUMA hinting scan: only mark pages that live off the local
+ * node, favour VMAs where the last pass found such pages, and adapt the
+ * scan period to how many hinting faults end up promoting a page.
+ */
+SCHED_FEAT(NUMA_TIER_SCAN, false)
+
 SCHED_FEAT(WA_IDLE, true)
 SCHED_FEAT(WA_WEIGHT, true)
 SCHED_FEAT(WA_BIAS, true)
@@ -15,6 +15,7 @@
 #include <linux/hugetlb.h>
 #include <linux/mm_inline.h>
 #include <linux/page_idle.h>
+#include <linux/page_age.h>
 #include <linux/page-flags.h>
 #include <linux/ksm.h>
 #include <linux/memcontrol.h>
@@ -267,6 +268,8 @@ static void exchange_page_flags(struct page *to_page, struct page *from_page)
 	page_cpupid_xchg_last(to_page, from_cpupid);
 	page_cpupid_xchg_last(from_page, to_cpupid);
 
+	exchange_page_age(to_page, from_page);
+
 	ksm_exchange_page(to_page, from_page);
 	/*
 	 * Please do not reorder this without considering how mm/ksm.c's
@@ -290,6 +293,28 @@ static void exchange_page_flags(struct page *to_page, struct page *from_page)
 
 }
 
+/* lock the tree_lock of one or two mappings, in address order */
+static void exchange_lock_mappings(struct address_space *mapping1,
+				struct address_space *mapping2)
+{
+	if (mapping1 == mapping2) {
+		spin_lock(&mapping1->tree_lock);
+		return;
+	}
+	if (mapping1 > mapping2)
+		swap(mapping1, mapping2);
+	spin_lock(&mapping1->tree_lock);
+	spin_lock_nested(&mapping2->tree_lock, SINGLE_DEPTH_NESTING);
+}
+
+static void exchange_unlock_mappings(struct address_space *mapping1,
+				struct address_space *mapping2)
+{
+	spin_unlock(&mapping1->tree_lock);
+	if (mapping1 != mapping2)
+		spin_unlock(&mapping2->tree_lock);
+}
+
 /*
  * Replace the page in the mapping.
  *
@@ -409,6 +434,12 @@ static int exchange_page_move_mapping(struct address_space *to_mapping,
 		else
 			VM_BUG_ON_PAGE(PageSwapCache(from_page), from_page);
 
+		/* the swap entry follows PageSwapCache, see exchange_page_flags() */
+		if (PageSwapCache(to_page)) {
+			set_page_private(from_page, page_private(to_page));
+			set_page_private(to_page, 0);
+		}
+
 		dirty = PageDirty(to_page);
 
 		radix_tree_replace_slot(&to_mapping->page_tree, to_pslot, from_page);
@@ -444,10 +475,124 @@ static int exchange_page_move_mapping(struct address_space *to_mapping,
 		}
 		local_irq_enable();
 
-	} else {
+	} else if (from_mapping && !to_mapping) {
 		/* from is file-backed to is anonymous: fold this to the case above */
-		/* both are file-backed  */
-		BUG();
+		return exchange_page_move_mapping(from_mapping, to_mapping,
+				from_page, to_page, from_head, to_head, mode,
+				from_extra_count, to_extra_count);
+	} else {
+		/* both are file-backed: only shmem and swap cache pages for now */
+		struct zone *from_zone, *to_zone;
+		void **from_pslot, **to_pslot;
+		int from_dirty, to_dirty;
+		int from_shmem, to_shmem;
+		unsigned long private;
+
+		if (to_head || from_head ||
+			page_has_private(to_page) || page_has_private(from_page))
+			return -EBUSY;
+
+		from_zone = page_zone(from_page);
+		to_zone = page_zone(to_page);
+
+		local_irq_disable();
+		exchange_lock_mappings(to_mapping, from_mapping);
+
+		to_pslot = radix_tree_lookup_slot(&to_mapping->page_tree,
+				page_index(to_page));
+		from_pslot = radix_tree_lookup_slot(&from_mapping->page_tree,
+				page_index(from_page));
+
+		to_expected_count += 1;
+		from_expected_count += 1;
+		if (page_count(to_page) != to_expected_count ||
+			page_count(from_page) != from_expected_count ||
+			radix_tree_deref_slot_protected(to_pslot, &to_mapping->tree_lock)
+			!= to_page ||
+			radix_tree_deref_slot_protected(from_pslot, &from_mapping->tree_lock)
+			!= from_page) {
+			exchange_unlock_mappings(to_mapping, from_mapping);
+			local_irq_enable();
+			return -EAGAIN;
+		}
+
+		if (!page_ref_freeze(to_page, to_expected_count)) {
+			exchange_unlock_mappings(to_mapping, from_mapping);
+			local_irq_enable();
+			return -EAGAIN;
+		}
+		if (!page_ref_freeze(from_page, from_expected_count)) {
+			page_ref_unfreeze(to_page, to_expected_count);
+			exchange_unlock_mappings(to_mapping, from_mapping);
+			local_irq_enable();
+			return -EAGAIN;
+		}
+
+		/*
+		 * Now we know that no one else is looking at the pages:
+		 * no turning back from here.
+		 */
+		from_shmem = from_swapbacked && !PageSwapCache(from_page);
+		to_shmem = to_swapbacked && !PageSwapCache(to_page);
+
+		/* from_page  */
+		from_page->index = to_page_index;
+		from_page->mapping = to_mapping_value;
+		/* to_page  */
+		to_page->index = from_page_index;
+		to_page->mapping = from_mapping_value;
+
+		ClearPageSwapBacked(from_page);
+		ClearPageSwapBacked(to_page);
+		if (to_swapbacked)
+			__SetPageSwapBacked(from_page);
+		if (from_swapbacked)
+			__SetPageSwapBacked(to_page);
+
+		/* the swap entry follows PageSwapCache, see exchange_page_flags() */
+		private = page_private(from_page);
+		set_page_private(from_page, page_private(to_page));
+		set_page_private(to_page, private);
+
+		from_dirty = PageDirty(from_page);
+		to_dirty = PageDirty(to_page);
+
+		/* each page keeps the cache reference of the slot it moves to */
+		radix_tree_replace_slot(&to_mapping->page_tree, to_pslot, from_page);
+		radix_tree_replace_slot(&from_mapping->page_tree, from_pslot, to_page);
+
+		page_ref_unfreeze(from_page, from_expected_count);
+		page_ref_unfreeze(to_page, to_expected_count);
+
+		exchange_unlock_mappings(to_mapping, from_mapping);
+
+		/*
+		 * NR_FILE_PAGES moves one page each way between the zones and
+		 * stays balanced; shmem and dirty pages may not.
+		 */
+		if (to_zone != from_zone) {
+			if (to_shmem) {
+				__dec_node_state(to_zone->zone_pgdat, NR_SHMEM);
+				__inc_node_state(from_zone->zone_pgdat, NR_SHMEM);
+			}
+			if (from_shmem) {
+				__dec_node_state(from_zone->zone_pgdat, NR_SHMEM);
+				__inc_node_state(to_zone->zone_pgdat, NR_SHMEM);
+			}
+			if (to_dirty && mapping_cap_account_dirty(to_mapping)) {
+				__dec_node_state(to_zone->zone_pgdat, NR_FILE_DIRTY);
+				__dec_zone_state(to_zone, NR_ZONE_WRITE_PENDING);
+				__inc_node_state(from_zone->zone_pgdat, NR_FILE_DIRTY);
+				__inc_zone_state(from_zone, NR_ZONE_WRITE_PENDING);
+			}
+			if (from_dirty && mapping_cap_account_dirty(from_mapping)) {
+				__dec_node_state(from_zone->zone_pgdat, NR_FILE_DIRTY);
+				__dec_zone_state(from_zone, NR_ZONE_WRITE_PENDING);
+				__inc_node_state(to_zone->zone_pgdat, NR_FILE_DIRTY);
+				__inc_zone_state(to_zone, NR_ZONE_WRITE_PENDING);
+			}
+		}
+		local_irq_enable();
 	}
 
 	return MIGRATEPAGE_SUCCESS;
@@ -470,16 +615,20 @@ static int exchange_from_to_pages(struct page *to_page, struct page *from_page,
 	to_page_mapping = page_mapping(to_page);
 	from_page_mapping = page_mapping(from_page);
 
-	/* from_page has to be anonymous page  */
-	BUG_ON(from_page_mapping);
+	/* from_page has to be anonymous, shmem or swap cache page  */
+	BUG_ON(!page_mapping_concur_movable(from_page));
 	BUG_ON(PageWriteback(from_page));
 	/* writeback has to finish */
 	BUG_ON(PageWriteback(to_page));
 
 	pr_dump_page(from_page, "exchange anonymous page: from ");
 
+	/* a shmem or swap cache from_page only pairs with a page like itself */
+	if (from_page_mapping && !page_mapping_concur_movable(to_page))
+		return -EBUSY;
+
 	/* to_page is anonymous  */
-	if (!to_page_mapping) {
+	if (!to_page_mapping || from_page_mapping) {
 		pr_dump_page(to_page, "exchange anonymous page: to ");
 exchange_mappings:
 		/* actual page mapping exchange */
@@ -630,7 +779,7 @@ static int unmap_and_exchange(struct page *from_page,
 
 	if (!trylock_page(to_page)) {
 		if ((mode & MIGRATE_MODE_MASK) == MIGRATE_ASYNC)
-			goto out;
+			goto out_unlock;
 		lock_page(to_page);
 	}
 
@@ -641,10 +790,7 @@ static int unmap_and_exchange(struct page *from_page,
 	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
 
-	/* from_page is supposed to be an anonymous page */
-	VM_BUG_ON_PAGE(PageWriteback(from_page), from_page);
-
-	if (PageWriteback(to_page)) {
+	if (PageWriteback(from_page) || PageWriteback(to_page)) {
 		/*
 		 * Only in the case of a full synchronous migration is it
 		 * necessary to wait for PageWriteback. In the async case,
@@ -653,8 +799,10 @@ static int unmap_and_exchange(struct page *from_page,
 		 */
 		if ((mode & MIGRATE_MODE_MASK) != MIGRATE_SYNC) {
 			rc = -EBUSY;
-			goto out_unlock;
+			goto out_unlock_both;
 		}
+		/* from_page can be a shmem or swap cache page */
+		wait_on_page_writeback(from_page);
 		wait_on_page_writeback(to_page);
 	}
 
@@ -956,7 +1104,7 @@ int exchange_pages(struct list_head *exchange_list,
 
 		/* TODO: compound page not supported */
 		if (!can_be_exchanged(from_page, to_page) ||
-			page_mapping(from_page)
+			!page_mapping_concur_movable(from_page)
 			/* allow to_page to be file-backed page  */
 			/*|| page_mapping(to_page)*/
 			) {
@@ -1085,7 +1233,11 @@ static int unmap_pair_pages_concur(struct exchange_page_info *one_pair,
 		lock_page(from_page);
 	}
 
-	BUG_ON(PageWriteback(from_page));
+	/* shmem and swap cache pages under writeback take the serial path */
+	if (PageWriteback(from_page)) {
+		rc = -ENODEV;
+		goto out_unlock;
+	}
 
 	/*
 	 * By try_to_unmap(), page->mapcount goes down to 0 here. In this case,
@@ -1120,7 +1272,10 @@ static int unmap_pair_pages_concur(struct exchange_page_info *one_pair,
 	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
 
-	BUG_ON(PageWriteback(to_page));
+	if (PageWriteback(to_page)) {
+		rc = -ENODEV;
+		goto out_unlock_both;
+	}
 
 	/*
 	 * By try_to_unmap(), page->mapcount goes down to 0 here. In this case,
@@ -1158,12 +1313,9 @@ static int unmap_pair_pages_concur(struct exchange_page_info *one_pair,
 			goto out_unlock_both;
 		}
 	} else if (page_mapped(from_page)) {
-		/* Establish migration ptes */
+		/* Migration ptes are established in try_to_unmap_pairs_concur() */
 		VM_BUG_ON_PAGE(PageAnon(from_page) && !PageKsm(from_page) &&
 					   !anon_vma_from_page, from_page);
-		try_to_unmap(from_page,
-			TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
-
 		one_pair->from_page_was_mapped = 1;
 	}
 
@@ -1174,12 +1326,9 @@ static int unmap_pair_pages_concur(struct exchange_page_info *one_pair,
 			goto out_unlock_both;
 		}
 	} else if (page_mapped(to_page)) {
-		/* Establish migration ptes */
+		/* Migration ptes are established in try_to_unmap_pairs_concur() */
 		VM_BUG_ON_PAGE(PageAnon(to_page) && !PageKsm(to_page) &&
 					   !anon_vma_to_page, to_page);
-		try_to_unmap(to_page,
-			TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
-
 		one_pair->to_page_was_mapped = 1;
 	}
 
@@ -1199,6 +1348,45 @@ static int unmap_pair_pages_concur(struct exchange_page_info *one_pair,
 	return rc;
 }
 
+static void try_to_unmap_pairs_concur(struct list_head *unmapped_list_ptr)
+{
+	struct exchange_page_info *one_pair;
+	struct page **page_list;
+	int num_pages = 0, idx = 0;
+
+	list_for_each_entry(one_pair, unmapped_list_ptr, list)
+		num_pages += one_pair->from_page_was_mapped +
+			one_pair->to_page_was_mapped;
+
+	if (!num_pages)
+		return;
+
+	page_list = kmalloc_array(num_pages, sizeof(struct page *), GFP_KERNEL);
+
+	list_for_each_entry(one_pair, unmapped_list_ptr, list) {
+		if (one_pair->from_page_was_mapped) {
+			if (page_list)
+				page_list[idx++] = one_pair->from_page;
+			else
+				try_to_unmap(one_pair->from_page,
+					TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
+		}
+		if (one_pair->to_page_was_mapped) {
+			if (page_list)
+				page_list[idx++] = one_pair->to_page;
+			else
+				try_to_unmap(one_pair->to_page,
+					TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
+		}
+	}
+
+	if (page_list) {
+		try_to_unmap_batch(page_list, num_pages,
+			TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
+		kfree(page_list);
+	}
+}
+
 static int exchange_page_mapping_concur(struct list_head *unmapped_list_ptr,
 					   struct list_head *exchange_list_ptr,
 						enum migrate_mode mode)
@@ -1219,8 +1407,9 @@ static int exchange_page_mapping_concur(struct list_head *unmapped_list_ptr,
 		to_page_mapping = page_mapping(to_page);
 		from_page_mapping = page_mapping(from_page);
 
-		BUG_ON(from_page_mapping);
-		BUG_ON(to_page_mapping);
+		/* anonymous, shmem or swap cache pages only */
+		VM_BUG_ON_PAGE(!page_mapping_concur_movable(from_page), from_page);
+		VM_BUG_ON_PAGE(!page_mapping_concur_movable(to_page), to_page);
 
 		BUG_ON(PageWriteback(from_page));
 		BUG_ON(PageWriteback(to_page));
@@ -1339,34 +1528,91 @@ static int exchange_page_data_concur(struct list_head *unmapped_list_ptr,
 	return rc;
 }
 
+/*
+ * Remap one side of every pair in a batch: from_page's migration entries to
+ * to_page if @from_side, to_page's migration entries to from_page otherwise.
+ *
+ * In remove_migration_ptes(), page_walk_vma() assumes the old page and the
+ * new page have the same index, so the old page's index is restored for the
+ * duration of the remap.
+ */
+static void remove_migration_ptes_pairs_concur(struct list_head *unmapped_list_ptr,
+		struct page **old_page_list, struct page **new_page_list,
+		bool from_side)
+{
+	struct exchange_page_info *iterator;
+	int num_pages = 0;
+
+	list_for_each_entry(iterator, unmapped_list_ptr, list) {
+		struct page *old_page = from_side ? iterator->from_page :
+							iterator->to_page;
+		struct page *new_page = from_side ? iterator->to_page :
+							iterator->from_page;
+		pgoff_t *old_index = from_side ? &iterator->from_index :
+							&iterator->to_index;
+
+		swap(old_page->index, *old_index);
+		if (!(from_side ? iterator->from_page_was_mapped :
+				  iterator->to_page_was_mapped))
+			continue;
+
+		if (old_page_list) {
+			old_page_list[num_pages] = old_page;
+			new_page_list[num_pages] = new_page;
+			++num_pages;
+		} else
+			remove_migration_ptes(old_page, new_page, false);
+	}
+
+	if (old_page_list)
+		remove_migration_ptes_batch(old_page_list, new_page_list, num_pages);
+
+	list_for_each_entry(iterator, unmapped_list_ptr, list) {
+		if (from_side)
+			swap(iterator->from_page->index, iterator->from_index);
+		else
+			swap(iterator->to_page->index, iterator->to_index);
+	}
+}
+
 static int remove_migration_ptes_concur(struct list_head *unmapped_list_ptr)
 {
 	struct exchange_page_info *iterator;
+	struct page **old_page_list, **new_page_list = NULL;
+	int num_pages = 0;
+	LIST_HEAD(putback_list);
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
 	u64 timestamp;
 #endif
 
-	list_for_each_entry(iterator, unmapped_list_ptr, list) {
-		struct page *from_page = iterator->from_page;
-		struct page *to_page = iterator->to_page;
+	list_for_each_entry(iterator, unmapped_list_ptr, list)
+		++num_pages;
 
-		swap(from_page->index, iterator->from_index);
-		if (iterator->from_page_was_mapped)
-			remove_migration_ptes(iterator->from_page, iterator->to_page, false);
-		swap(from_page->index, iterator->from_index);
+	old_page_list = kmalloc_array(num_pages, sizeof(struct page *), GFP_KERNEL);
+	if (old_page_list)
+		new_page_list = kmalloc_array(num_pages, sizeof(struct page *),
+					GFP_KERNEL);
+	if (!new_page_list) {
+		kfree(old_page_list);
+		old_page_list = NULL;
+	}
+
+	remove_migration_ptes_pairs_concur(unmapped_list_ptr, old_page_list,
+			new_page_list, true);
+	remove_migration_ptes_pairs_concur(unmapped_list_ptr, old_page_list,
+			new_page_list, false);
 
-		swap(to_page->index, iterator->to_index);
-		if (iterator->to_page_was_mapped)
-			remove_migration_ptes(iterator->to_page, iterator->from_page, false);
-		swap(to_page->index, iterator->to_index);
+	kfree(old_page_list);
+	kfree(new_page_list);
 
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
-		timestamp = rdtsc();
-		current->move_pages_breakdown.remove_migration_ptes_cycles += timestamp -
-			current->move_pages_breakdown.last_timestamp;
-		current->move_pages_breakdown.last_timestamp = timestamp;
+	timestamp = rdtsc();
+	current->move_pages_breakdown.remove_migration_ptes_cycles += timestamp -
+		current->move_pages_breakdown.last_timestamp;
+	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
 
+	list_for_each_entry(iterator, unmapped_list_ptr, list) {
 		if (iterator->from_anon_vma)
 			put_anon_vma(iterator->from_anon_vma);
 		unlock_page(iterator->from_page);
@@ -1377,26 +1623,22 @@ static int remove_migration_ptes_concur(struct list_head *unmapped_list_ptr)
 		unlock_page(iterator->to_page);
 
 
-		putback_lru_page(iterator->from_page);
+		list_add_tail(&iterator->from_page->lru, &putback_list);
 		iterator->from_page = NULL;
 
-#ifdef CONFIG_PAGE_MIGRATION_PROFILE
-		timestamp = rdtsc();
-		current->move_pages_breakdown.putback_old_page_cycles += timestamp -
-			current->move_pages_breakdown.last_timestamp;
-		current->move_pages_breakdown.last_timestamp = timestamp;
-#endif
-
-		putback_lru_page(iterator->to_page);
+		list_add_tail(&iterator->to_page->lru, &putback_list);
 		iterator->to_page = NULL;
+	}
+
+	/* Both pages of every pair go back under one lru_lock per node */
+	putback_lru_pages(&putback_list);
 
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
-		timestamp = rdtsc();
-		current->move_pages_breakdown.putback_new_page_cycles += timestamp -
-			current->move_pages_breakdown.last_timestamp;
-		current->move_pages_breakdown.last_timestamp = timestamp;
+	timestamp = rdtsc();
+	current->move_pages_breakdown.putback_new_page_cycles += timestamp -
+		current->move_pages_breakdown.last_timestamp;
+	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
-	}
 
 	return 0;
 }
@@ -1470,12 +1712,15 @@ int exchange_pages_concur(struct list_head *exchange_list,
 				list_del(&one_pair->list);
 				continue;
 			}
-		/* We do not exchange huge pages and file-backed pages concurrently */
+		/*
+		 * We do not exchange huge pages and file-backed pages other than
+		 * shmem and swap cache pages concurrently
+		 */
 			if (PageHuge(one_pair->from_page) || PageHuge(one_pair->to_page)) {
 				rc = -ENODEV;
 			}
-			else if ((page_mapping(one_pair->from_page) != NULL) ||
-					 (page_mapping(one_pair->from_page) != NULL)) {
+			else if (!page_mapping_concur_movable(one_pair->from_page) ||
+					 !page_mapping_concur_movable(one_pair->to_page)) {
 				rc = -ENODEV;
 			}
 			else
@@ -1507,6 +1752,9 @@ int exchange_pages_concur(struct list_head *exchange_list,
 			}
 		}
 
+		/* establish migration ptes for the whole batch */
+		try_to_unmap_pairs_concur(&unmapped_list);
+
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
 		timestamp = rdtsc();
 		current->move_pages_breakdown.unmap_page_cycles += timestamp -
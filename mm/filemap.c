@@ -848,6 +848,28 @@ struct page *__page_cache_alloc(gfp_t gfp)
 	return alloc_pages(gfp, 0);
 }
 EXPORT_SYMBOL(__page_cache_alloc);
+
+/*
+ * Readahead and read misses fill the page cache with pages that may never
+ * be used again. If the task's memcg names a page cache node, normally its
+ * slow memory tier, allocate them there instead of displacing the hot set.
+ * Pages that are touched again get activated by mark_page_accessed() and
+ * are promoted by mm_manage like any other hot page.
+ */
+struct page *__page_cache_alloc_use_once(gfp_t gfp)
+{
+	int nid = mem_cgroup_page_cache_node(current);
+
+	if (nid != NUMA_NO_NODE && !cpuset_do_page_mem_spread() &&
+	    cpuset_node_allowed(nid, gfp)) {
+		struct page *page;
+
+		page = __alloc_pages_node(nid, gfp | __GFP_THISNODE, 0);
+		if (page)
+			return page;
+	}
+	return __page_cache_alloc(gfp);
+}
 #endif
 
 /*
@@ -2158,7 +2180,7 @@ static ssize_t generic_file_buffered_read(struct kiocb *iocb,
 		 * Ok, it wasn't cached, so we need to create a new
 		 * page..
 		 */
-		page = page_cache_alloc_cold(mapping);
+		page = page_cache_alloc_use_once(mapping);
 		if (!page) {
 			error = -ENOMEM;
 			goto out;
@@ -287,6 +287,110 @@ int __frontswap_store(struct page *page)
 }
 EXPORT_SYMBOL(__frontswap_store);
 
+/*
+ * Store a run of pages that all belong to swap type @type, handing each
+ * implementation the pages that the previous ones did not take.
+ */
+static void __frontswap_store_type_batch(int type, struct page **pages,
+					 int nr, int *rets)
+{
+	struct swap_info_struct *sis = swap_info[type];
+	struct page *batch_pages[FRONTSWAP_BATCH_MAX];
+	pgoff_t batch_offsets[FRONTSWAP_BATCH_MAX];
+	int batch_rets[FRONTSWAP_BATCH_MAX];
+	int batch_idx[FRONTSWAP_BATCH_MAX];
+	struct frontswap_ops *ops;
+	int i, nr_batch;
+
+	VM_BUG_ON(sis == NULL);
+
+	for (i = 0; i < nr; i++) {
+		swp_entry_t entry = { .val = page_private(pages[i]), };
+		pgoff_t offset = swp_offset(entry);
+
+		VM_BUG_ON(!PageLocked(pages[i]));
+
+		/* see __frontswap_store() */
+		if (__frontswap_test(sis, offset)) {
+			__frontswap_clear(sis, offset);
+			for_each_frontswap_ops(ops)
+				ops->invalidate_page(type, offset);
+		}
+		rets[i] = -1;
+	}
+
+	/* Try to store in each implementation, until one succeeds. */
+	for_each_frontswap_ops(ops) {
+		nr_batch = 0;
+		for (i = 0; i < nr; i++) {
+			swp_entry_t entry = { .val = page_private(pages[i]), };
+
+			if (!rets[i])
+				continue;
+			batch_pages[nr_batch] = pages[i];
+			batch_offsets[nr_batch] = swp_offset(entry);
+			batch_idx[nr_batch] = i;
+			nr_batch++;
+		}
+		if (!nr_batch)
+			break;
+
+		if (ops->store_batch)
+			ops->store_batch(type, batch_offsets, batch_pages,
+					 nr_batch, batch_rets);
+		else
+			for (i = 0; i < nr_batch; i++)
+				batch_rets[i] = ops->store(type,
+						batch_offsets[i], batch_pages[i]);
+
+		for (i = 0; i < nr_batch; i++)
+			rets[batch_idx[i]] = batch_rets[i];
+	}
+
+	for (i = 0; i < nr; i++) {
+		swp_entry_t entry = { .val = page_private(pages[i]), };
+
+		if (rets[i] == 0) {
+			__frontswap_set(sis, swp_offset(entry));
+			inc_frontswap_succ_stores();
+		} else {
+			inc_frontswap_failed_stores();
+		}
+		if (frontswap_writethrough_enabled)
+			/* report failure so swap also writes to swap device */
+			rets[i] = -1;
+	}
+}
+
+/*
+ * Batched version of __frontswap_store() for up to FRONTSWAP_BATCH_MAX
+ * pages, so that implementations providing ->store_batch can compress
+ * them in parallel. rets[i] follows the __frontswap_store() convention
+ * for pages[i].
+ */
+void __frontswap_store_batch(struct page **pages, int nr, int *rets)
+{
+	int start, end, type;
+
+	VM_BUG_ON(!frontswap_ops);
+	VM_BUG_ON(nr > FRONTSWAP_BATCH_MAX);
+
+	for (start = 0; start < nr; start = end) {
+		swp_entry_t entry = { .val = page_private(pages[start]), };
+
+		type = swp_type(entry);
+		for (end = start + 1; end < nr; end++) {
+			swp_entry_t next = { .val = page_private(pages[end]), };
+
+			if (swp_type(next) != type)
+				break;
+		}
+		__frontswap_store_type_batch(type, pages + start, end - start,
+					     rets + start);
+	}
+}
+EXPORT_SYMBOL(__frontswap_store_batch);
+
 /*
  * "Get" data from frontswap associated with swaptype and offset that were
  * specified when the data was put to frontswap and use it to fill the
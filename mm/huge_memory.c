@@ -297,6 +297,22 @@ static ssize_t hpage_pmd_size_show(struct kobject *kobj,
 static struct kobj_attribute hpage_pmd_size_attr =
 	__ATTR_RO(hpage_pmd_size);
 
+static ssize_t cow_mt_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return single_hugepage_flag_show(kobj, attr, buf,
+				TRANSPARENT_HUGEPAGE_COW_MT_FLAG);
+}
+static ssize_t cow_mt_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	return single_hugepage_flag_store(kobj, attr, buf, count,
+				 TRANSPARENT_HUGEPAGE_COW_MT_FLAG);
+}
+static struct kobj_attribute cow_mt_attr =
+	__ATTR(cow_mt, 0644, cow_mt_show, cow_mt_store);
+
 #ifdef CONFIG_DEBUG_VM
 static ssize_t debug_cow_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
@@ -320,6 +336,7 @@ static struct attribute *hugepage_attr[] = {
 	&defrag_attr.attr,
 	&use_zero_page_attr.attr,
 	&hpage_pmd_size_attr.attr,
+	&cow_mt_attr.attr,
 #if defined(CONFIG_SHMEM) && defined(CONFIG_TRANSPARENT_HUGE_PAGECACHE)
 	&shmem_enabled_attr.attr,
 #endif
@@ -1280,12 +1297,20 @@ int do_huge_pmd_wp_page(struct vm_fault *vmf, pmd_t orig_pmd)
 	get_page(page);
 	spin_unlock(vmf->ptl);
 alloc:
+	new_page = NULL;
 	if (transparent_hugepage_enabled(vma) &&
 	    !transparent_hugepage_debug_cow()) {
+		int nid = cow_target_node(vma, haddr, page);
+
 		huge_gfp = alloc_hugepage_direct_gfpmask(vma);
-		new_page = alloc_hugepage_vma(huge_gfp, vma, haddr, HPAGE_PMD_ORDER);
-	} else
-		new_page = NULL;
+		if (nid != NUMA_NO_NODE)
+			new_page = alloc_pages_node(nid, huge_gfp |
+					__GFP_THISNODE | __GFP_NORETRY,
+					HPAGE_PMD_ORDER);
+		if (!new_page)
+			new_page = alloc_hugepage_vma(huge_gfp, vma, haddr,
+						      HPAGE_PMD_ORDER);
+	}
 
 	if (likely(new_page)) {
 		prep_transhuge_page(new_page);
@@ -1320,7 +1345,8 @@ int do_huge_pmd_wp_page(struct vm_fault *vmf, pmd_t orig_pmd)
 
 	if (!page)
 		clear_huge_page(new_page, vmf->address, HPAGE_PMD_NR);
-	else
+	else if (!transparent_hugepage_cow_mt() ||
+		 copy_page_multithread(new_page, page, HPAGE_PMD_NR))
 		copy_user_huge_page(new_page, page, haddr, vma, HPAGE_PMD_NR);
 	__SetPageUptodate(new_page);
 
@@ -1872,6 +1898,11 @@ int change_huge_pmd(struct vm_area_struct *vma, pmd_t *pmd,
 	if (prot_numa && pmd_protnone(*pmd))
 		goto unlock;
 
+	/* Already on the fast tier, no hinting fault wanted */
+	if (prot_numa == PROT_NUMA_TIER &&
+	    page_to_nid(pmd_page(*pmd)) == numa_node_id())
+		goto unlock;
+
 	/*
 	 * In case prot_numa, we are under down_read(mmap_sem). It's critical
 	 * to not clear pmd intermittently to avoid race with MADV_DONTNEED
@@ -91,6 +91,10 @@ extern unsigned long highest_memmap_pfn;
  */
 extern int isolate_lru_page(struct page *page);
 extern void putback_lru_page(struct page *page);
+extern void putback_lru_pages(struct list_head *page_list);
+extern int demotion_target_node(pg_data_t *pgdat);
+extern int cow_target_node(struct vm_area_struct *vma, unsigned long addr,
+			   struct page *src);
 
 /*
  * in mm/rmap.c:
@@ -495,6 +499,7 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 #define ALLOC_HIGH		0x20 /* __GFP_HIGH set */
 #define ALLOC_CPUSET		0x40 /* check for correct cpuset */
 #define ALLOC_CMA		0x80 /* allow allocations from CMA areas */
+#define ALLOC_PROMOTE		0x100 /* may use the node's promotion reserve */
 
 enum ttu_flags;
 struct tlbflush_unmap_batch;
@@ -538,6 +543,8 @@ static inline bool is_migrate_highatomic_page(struct page *page)
 
 void setup_zone_pageset(struct zone *zone);
 extern struct page *alloc_new_node_page(struct page *page, unsigned long node);
+extern int migration_batch_size;
+extern bool vma_tier_hints_used;
 
 extern int copy_page_lists_dma_always(struct page **to,
 			struct page **from, int nr_pages);
@@ -563,5 +570,8 @@ unsigned move_active_pages_to_lru(struct lruvec *lruvec,
 				     struct list_head *pages_to_free,
 				     enum lru_list lru);
 void putback_inactive_pages(struct lruvec *lruvec, struct list_head *page_list);
+unsigned long reclaim_pages_from_list(struct pglist_data *pgdat,
+				      struct list_head *page_list);
+bool page_mapping_concur_movable(struct page *page);
 
 #endif	/* __MM_INTERNAL_H */
@@ -39,6 +39,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/migrate.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -271,6 +272,14 @@ static int ksm_nr_node_ids = 1;
 #define ksm_nr_node_ids		1
 #endif
 
+#ifdef CONFIG_NUMA
+/* Node hot stable pages are promoted to, NUMA_NO_NODE when disabled */
+static int ksm_promote_node = NUMA_NO_NODE;
+#endif
+
+/* Referenced mappings, summed over all sharers, that make a ksm page hot */
+static unsigned int ksm_promote_min_heat = 1;
+
 #define KSM_RUN_STOP	0
 #define KSM_RUN_MERGE	1
 #define KSM_RUN_UNMERGE	2
@@ -2175,6 +2184,151 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+static bool ksm_page_young_one(struct page *page, struct vm_area_struct *vma,
+			       unsigned long addr, void *arg)
+{
+	struct page_vma_mapped_walk pvmw = {
+		.page = page,
+		.vma = vma,
+		.address = addr,
+	};
+	int *heat = arg;
+
+	while (page_vma_mapped_walk(&pvmw)) {
+		if (pte_young(*pvmw.pte) ||
+		    mmu_notifier_test_young(vma->vm_mm, pvmw.address))
+			(*heat)++;
+	}
+
+	return true;
+}
+
+/*
+ * The heat of a ksm page is the number of young ptes found by walking the
+ * rmap_items of every sharer, whichever mm or memcg they belong to: a page
+ * idle in one process can still be hot because of all the others.
+ *
+ * The young bits are only tested, not cleared, so that mm_manage aging
+ * still finds them. Like page_referenced(), a page we cannot lock counts
+ * as referenced.
+ */
+static int ksm_page_heat(struct page *page)
+{
+	struct rmap_walk_control rwc = {
+		.rmap_one = ksm_page_young_one,
+	};
+	int heat = 0;
+
+	if (!page_mapped(page))
+		return 0;
+
+	if (!trylock_page(page))
+		return 1;
+
+	rwc.arg = &heat;
+	rmap_walk(page, &rwc);
+	unlock_page(page);
+
+	return heat;
+}
+
+/**
+ * ksm_page_hot - check whether a ksm page is hot across all its sharers
+ * @page: the page to check
+ *
+ * Used by the tiering code, which only sees the ksm page on the LRU of the
+ * memcg it is charged to, to avoid demoting a page other sharers still use.
+ */
+bool ksm_page_hot(struct page *page)
+{
+	if (!PageKsm(page))
+		return false;
+
+	return ksm_page_heat(page) >= READ_ONCE(ksm_promote_min_heat);
+}
+
+#ifdef CONFIG_NUMA
+static void ksm_promote_batch(struct list_head *page_list, int nid)
+{
+	unsigned int promote_flags;
+
+	if (list_empty(page_list))
+		return;
+
+	promote_flags = memalloc_promote_save();
+	if (migrate_pages_concur(page_list, alloc_new_node_page, NULL, nid,
+				 MIGRATE_SYNC | MIGRATE_CONCUR,
+				 MR_NUMA_MISPLACED))
+		putback_movable_pages(page_list);
+	memalloc_promote_restore(promote_flags);
+}
+
+static void ksm_isolate_hot_page(struct stable_node *stable_node, int nid,
+				 struct list_head *page_list, int *nr_pages)
+{
+	struct page *page;
+
+	page = get_ksm_page(stable_node, false);
+	if (!page)
+		return;
+
+	if (page_to_nid(page) != nid && PageLRU(page) &&
+	    ksm_page_heat(page) >= ksm_promote_min_heat &&
+	    !isolate_lru_page(page)) {
+		inc_node_page_state(page, NR_ISOLATED_ANON);
+		list_add_tail(&page->lru, page_list);
+		(*nr_pages)++;
+	}
+	put_page(page);
+}
+
+/*
+ * Once per full scan, move the stable pages whose aggregate heat reaches
+ * ksm_promote_min_heat to ksm_promote_node, migration_batch_size pages at
+ * a time. Called with ksm_thread_mutex held, so the stable tree is stable
+ * apart from the stale nodes get_ksm_page() removes on the way.
+ */
+static void ksm_promote_hot_pages(void)
+{
+	int nid = READ_ONCE(ksm_promote_node);
+	struct stable_node *stable_node, *dup;
+	struct hlist_node *hlist_safe;
+	struct rb_node *node, *next;
+	LIST_HEAD(page_list);
+	int root_nid, nr_pages = 0;
+
+	if (nid == NUMA_NO_NODE || !node_online(nid))
+		return;
+
+	for (root_nid = 0; root_nid < ksm_nr_node_ids; root_nid++) {
+		for (node = rb_first(root_stable_tree + root_nid); node;
+		     node = next) {
+			next = rb_next(node);
+			stable_node = rb_entry(node, struct stable_node, node);
+			if (is_stable_node_chain(stable_node)) {
+				hlist_for_each_entry_safe(dup, hlist_safe,
+						&stable_node->hlist, hlist_dup)
+					ksm_isolate_hot_page(dup, nid,
+							&page_list, &nr_pages);
+			} else
+				ksm_isolate_hot_page(stable_node, nid,
+						&page_list, &nr_pages);
+
+			if (nr_pages >= migration_batch_size) {
+				ksm_promote_batch(&page_list, nid);
+				nr_pages = 0;
+			}
+			cond_resched();
+		}
+	}
+	ksm_promote_batch(&page_list, nid);
+}
+#else
+static inline void ksm_promote_hot_pages(void)
+{
+}
+#endif
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -2329,6 +2483,7 @@ static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 	if (slot != &ksm_mm_head)
 		goto next_mm;
 
+	ksm_promote_hot_pages();
 	ksm_scan.seqnr++;
 	return NULL;
 }
@@ -2954,6 +3109,58 @@ static ssize_t merge_across_nodes_store(struct kobject *kobj,
 KSM_ATTR(merge_across_nodes);
 #endif
 
+#ifdef CONFIG_NUMA
+static ssize_t promote_node_show(struct kobject *kobj,
+				 struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", ksm_promote_node);
+}
+
+static ssize_t promote_node_store(struct kobject *kobj,
+				  struct kobj_attribute *attr,
+				  const char *buf, size_t count)
+{
+	int err;
+	int nid;
+
+	err = kstrtoint(buf, 10, &nid);
+	if (err)
+		return err;
+
+	if (nid != NUMA_NO_NODE &&
+	    (nid < 0 || nid >= MAX_NUMNODES || !node_online(nid)))
+		return -EINVAL;
+
+	WRITE_ONCE(ksm_promote_node, nid);
+
+	return count;
+}
+KSM_ATTR(promote_node);
+#endif
+
+static ssize_t promote_min_heat_show(struct kobject *kobj,
+				     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_promote_min_heat);
+}
+
+static ssize_t promote_min_heat_store(struct kobject *kobj,
+				      struct kobj_attribute *attr,
+				      const char *buf, size_t count)
+{
+	int err;
+	unsigned int heat;
+
+	err = kstrtouint(buf, 10, &heat);
+	if (err || !heat)
+		return -EINVAL;
+
+	WRITE_ONCE(ksm_promote_min_heat, heat);
+
+	return count;
+}
+KSM_ATTR(promote_min_heat);
+
 static ssize_t use_zero_pages_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
 {
@@ -3113,7 +3320,9 @@ static struct attribute *ksm_attrs[] = {
 	&full_scans_attr.attr,
 #ifdef CONFIG_NUMA
 	&merge_across_nodes_attr.attr,
+	&promote_node_attr.attr,
 #endif
+	&promote_min_heat_attr.attr,
 	&max_page_sharing_attr.attr,
 	&stable_node_chains_attr.attr,
 	&stable_node_dups_attr.attr,
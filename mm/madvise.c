@@ -29,6 +29,9 @@
 
 #include "internal.h"
 
+/* Set once any VMA carries a tier hint, lets page_tier_hint() bail early */
+bool vma_tier_hints_used __read_mostly;
+
 /*
  * Any behaviour which results in changes to the vma->vm_flags needs to
  * take mmap_sem for writing. Others, which simply traverse vmas, need
@@ -102,6 +105,20 @@ static long madvise_behavior(struct vm_area_struct *vma,
 		}
 		new_flags &= ~VM_DONTDUMP;
 		break;
+	case MADV_TIER_FAST:
+	case MADV_TIER_SLOW:
+		if (!VM_TIER_MASK || vma->vm_flags & VM_SPECIAL) {
+			error = -EINVAL;
+			goto out;
+		}
+		new_flags &= ~VM_TIER_MASK;
+		new_flags |= behavior == MADV_TIER_FAST ?
+			VM_TIER_FAST : VM_TIER_SLOW;
+		WRITE_ONCE(vma_tier_hints_used, true);
+		break;
+	case MADV_TIER_NONE:
+		new_flags &= ~VM_TIER_MASK;
+		break;
 	case MADV_MERGEABLE:
 	case MADV_UNMERGEABLE:
 		error = ksm_madvise(vma, start, end, behavior, &new_flags);
@@ -716,6 +733,11 @@ madvise_behavior_valid(int behavior)
 	case MADV_DODUMP:
 	case MADV_WIPEONFORK:
 	case MADV_KEEPONFORK:
+#ifdef CONFIG_NUMA
+	case MADV_TIER_FAST:
+	case MADV_TIER_SLOW:
+	case MADV_TIER_NONE:
+#endif
 #ifdef CONFIG_MEMORY_FAILURE
 	case MADV_SOFT_OFFLINE:
 	case MADV_HWPOISON:
@@ -774,6 +796,11 @@ madvise_behavior_valid(int behavior)
  *  MADV_DONTDUMP - the application wants to prevent pages in the given range
  *		from being included in its core dump.
  *  MADV_DODUMP - cancel MADV_DONTDUMP: no longer exclude from core dump.
+ *  MADV_TIER_FAST - the range holds hot data: memory tiering never demotes
+ *		its pages to slower nodes or picks them as exchange victims.
+ *  MADV_TIER_SLOW - the range holds bulk data: memory tiering allocates its
+ *		pages on slower nodes and never promotes them.
+ *  MADV_TIER_NONE - cancel MADV_TIER_FAST and MADV_TIER_SLOW.
  *
  * return values:
  *  zero    - success
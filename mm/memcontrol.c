@@ -4284,9 +4284,12 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 
 	memcg->high = PAGE_COUNTER_MAX;
 	memcg->soft_limit = PAGE_COUNTER_MAX;
+	memcg->page_cache_node = NUMA_NO_NODE;
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
 		memcg->oom_kill_disable = parent->oom_kill_disable;
+		memcg->swap_tier = parent->swap_tier;
+		memcg->page_cache_node = parent->page_cache_node;
 	}
 	if (parent && parent->use_hierarchy) {
 		memcg->use_hierarchy = true;
@@ -5374,6 +5377,61 @@ static int memory_stat_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+/*
+ * Node on which @p's readahead and use-once page cache is allocated, or
+ * NUMA_NO_NODE to follow the task's mempolicy. The node is not used once
+ * the memcg has filled its max_at_node limit there.
+ */
+int mem_cgroup_page_cache_node(struct task_struct *p)
+{
+	struct mem_cgroup *memcg;
+	int nid = NUMA_NO_NODE;
+
+	if (mem_cgroup_disabled())
+		return NUMA_NO_NODE;
+
+	rcu_read_lock();
+	memcg = mem_cgroup_from_task(p);
+	if (memcg && memcg != root_mem_cgroup)
+		nid = READ_ONCE(memcg->page_cache_node);
+	if (nid != NUMA_NO_NODE &&
+	    memcg_size_node(memcg, nid) >= memcg_max_size_node(memcg, nid))
+		nid = NUMA_NO_NODE;
+	rcu_read_unlock();
+
+	return nid;
+}
+
+static int memory_page_cache_node_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+
+	seq_printf(m, "%d\n", READ_ONCE(memcg->page_cache_node));
+
+	return 0;
+}
+
+static ssize_t memory_page_cache_node_write(struct kernfs_open_file *of,
+				char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	int nid;
+	int err;
+
+	buf = strstrip(buf);
+	err = kstrtoint(buf, 0, &nid);
+	if (err)
+		return err;
+
+	if (nid != NUMA_NO_NODE &&
+	    (nid < 0 || nid >= MAX_NUMNODES || !node_state(nid, N_MEMORY)))
+		return -EINVAL;
+
+	WRITE_ONCE(memcg->page_cache_node, nid);
+
+	return nbytes;
+}
+
 static struct cftype memory_files[] = {
 	{
 		.name = "current",
@@ -5409,6 +5467,12 @@ static struct cftype memory_files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.seq_show = memory_stat_show,
 	},
+	{
+		.name = "page_cache_node",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_page_cache_node_show,
+		.write = memory_page_cache_node_write,
+	},
 	{ }	/* terminate */
 };
 
@@ -6238,6 +6302,32 @@ static ssize_t swap_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+static int swap_tier_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(seq_css(m));
+
+	seq_printf(m, "%d\n", READ_ONCE(memcg->swap_tier));
+
+	return 0;
+}
+
+static ssize_t swap_tier_write(struct kernfs_open_file *of,
+			       char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	bool enable;
+	int err;
+
+	buf = strstrip(buf);
+	err = kstrtobool(buf, &enable);
+	if (err)
+		return err;
+
+	WRITE_ONCE(memcg->swap_tier, enable);
+
+	return nbytes;
+}
+
 static struct cftype swap_files[] = {
 	{
 		.name = "swap.current",
@@ -6250,6 +6340,12 @@ static struct cftype swap_files[] = {
 		.seq_show = swap_max_show,
 		.write = swap_max_write,
 	},
+	{
+		.name = "swap.tier",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = swap_tier_show,
+		.write = swap_tier_write,
+	},
 	{ }	/* terminate */
 };
 
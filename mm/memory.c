@@ -70,6 +70,8 @@
 #include <linux/userfaultfd_k.h>
 #include <linux/dax.h>
 #include <linux/oom.h>
+#include <linux/moduleparam.h>
+#include <linux/page_age.h>
 
 #include <asm/io.h>
 #include <asm/mmu_context.h>
@@ -2456,6 +2458,42 @@ static inline void wp_page_reuse(struct vm_fault *vmf)
 	pte_unmap_unlock(vmf->pte, vmf->ptl);
 }
 
+/*
+ * A page that was demoted to a slow node is no hotter for being written
+ * once after fork, so by default its COW copy stays on that node instead
+ * of following the policy to the fast one.
+ */
+static bool cow_inherit_tier __read_mostly = true;
+module_param(cow_inherit_tier, bool, 0644);
+
+/*
+ * Returns the node a COW copy of @src at @addr should be allocated on, or
+ * NUMA_NO_NODE to follow the vma policy.
+ */
+int cow_target_node(struct vm_area_struct *vma, unsigned long addr,
+		    struct page *src)
+{
+#ifdef CONFIG_NUMA
+	int nid, local = numa_node_id();
+
+	if (!src || !READ_ONCE(cow_inherit_tier) ||
+	    (vma->vm_flags & VM_TIER_FAST))
+		return NUMA_NO_NODE;
+
+	/* Only pages on a slow node while we run on a fast one */
+	nid = page_to_nid(src);
+	if (nid == local || READ_ONCE(NODE_DATA(nid)->promote_reserve) ||
+	    !READ_ONCE(NODE_DATA(local)->promote_reserve))
+		return NUMA_NO_NODE;
+	if (!mpol_node_allowed(vma, addr, nid))
+		return NUMA_NO_NODE;
+
+	return nid;
+#else
+	return NUMA_NO_NODE;
+#endif
+}
+
 /*
  * Handle the case of a page which we actually need to copy to a new page.
  *
@@ -2493,8 +2531,15 @@ static int wp_page_copy(struct vm_fault *vmf)
 		if (!new_page)
 			goto oom;
 	} else {
-		new_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma,
-				vmf->address);
+		int nid = cow_target_node(vma, vmf->address, old_page);
+
+		if (nid != NUMA_NO_NODE)
+			new_page = __alloc_pages_node(nid, GFP_HIGHUSER_MOVABLE |
+					__GFP_THISNODE | __GFP_NORETRY |
+					__GFP_NOWARN, 0);
+		if (!new_page)
+			new_page = alloc_page_vma(GFP_HIGHUSER_MOVABLE, vma,
+					vmf->address);
 		if (!new_page)
 			goto oom;
 		cow_user_page(new_page, old_page, vmf->address, vma);
@@ -2855,6 +2900,81 @@ void unmap_mapping_range(struct address_space *mapping,
 }
 EXPORT_SYMBOL(unmap_mapping_range);
 
+#ifdef CONFIG_THP_SWAP
+/*
+ * swapin_huge_cluster() read a whole PMD range of swap into the swap cache.
+ * Map the rest of it under the pte lock do_swap_page() already holds, so the
+ * range costs one fault. Pages that would need to sleep are left to their
+ * own faults.
+ */
+static void do_swap_map_cluster(struct vm_fault *vmf, swp_entry_t entry)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long haddr = vmf->address & HPAGE_PMD_MASK;
+	unsigned long fault_idx = (vmf->address - haddr) >> PAGE_SHIFT;
+	pte_t *pte = vmf->pte - fault_idx;
+	int i;
+
+	for (i = 0; i < HPAGE_PMD_NR; i++, pte++) {
+		unsigned long addr = haddr + i * PAGE_SIZE;
+		swp_entry_t ent = swp_entry(swp_type(entry),
+				swp_offset(entry) - fault_idx + i);
+		struct mem_cgroup *memcg;
+		struct anon_vma *anon_vma;
+		struct page *page;
+		pte_t orig = *pte, new;
+
+		if (i == fault_idx || pte_none(orig) || pte_present(orig) ||
+		    pte_to_swp_entry(orig).val != ent.val)
+			continue;
+
+		page = find_get_page(swap_address_space(ent), swp_offset(ent));
+		if (!page)
+			continue;
+		if (!trylock_page(page))
+			goto put;
+		if (!PageSwapCache(page) || page_private(page) != ent.val ||
+		    !PageUptodate(page))
+			goto unlock;
+		/* Leave pages ksm_might_need_to_copy() would copy to the fault */
+		anon_vma = page_anon_vma(page);
+		if (PageKsm(page) ||
+		    (anon_vma && (anon_vma->root != vma->anon_vma->root ||
+				  page->index != linear_page_index(vma, addr))))
+			goto unlock;
+		if (mem_cgroup_try_charge(page, vma->vm_mm, GFP_NOWAIT,
+					  &memcg, false))
+			goto unlock;
+
+		inc_mm_counter_fast(vma->vm_mm, MM_ANONPAGES);
+		dec_mm_counter_fast(vma->vm_mm, MM_SWAPENTS);
+		new = mk_pte(page, vma->vm_page_prot);
+		if (pte_swp_soft_dirty(orig))
+			new = pte_mksoft_dirty(new);
+		flush_icache_page(vma, page);
+		set_pte_at(vma->vm_mm, addr, pte, new);
+		do_page_add_anon_rmap(page, vma, addr, 0);
+		mem_cgroup_commit_charge(page, memcg, true, false);
+		activate_page(page);
+
+		swap_free(ent);
+		if (mem_cgroup_swap_full(page) ||
+		    (vma->vm_flags & VM_LOCKED) || PageMlocked(page))
+			try_to_free_swap(page);
+		update_mmu_cache(vma, addr, pte);
+unlock:
+		unlock_page(page);
+put:
+		put_page(page);
+	}
+}
+#else
+static inline void do_swap_map_cluster(struct vm_fault *vmf,
+				       swp_entry_t entry)
+{
+}
+#endif
+
 /*
  * We enter with non-exclusive mmap_sem (to exclude vma changes,
  * but allow concurrent faults), and pte mapped but not yet locked.
@@ -2875,6 +2995,7 @@ int do_swap_page(struct vm_fault *vmf)
 	int exclusive = 0;
 	int ret = 0;
 	bool vma_readahead = swap_use_vma_readahead();
+	bool swapin_cluster = false;
 
 	if (vma_readahead)
 		page = swap_readahead_detect(vmf, &swap_ra);
@@ -2910,7 +3031,10 @@ int do_swap_page(struct vm_fault *vmf)
 		page = lookup_swap_cache(entry, vma_readahead ? vma : NULL,
 					 vmf->address);
 	if (!page) {
-		if (vma_readahead)
+		page = swapin_huge_cluster(entry, vmf);
+		if (page)
+			swapin_cluster = true;
+		else if (vma_readahead)
 			page = do_swap_page_readahead(entry,
 				GFP_HIGHUSER_MOVABLE, vmf, &swap_ra);
 		else
@@ -3040,6 +3164,9 @@ int do_swap_page(struct vm_fault *vmf)
 		put_page(swapcache);
 	}
 
+	if (swapin_cluster && page == swapcache)
+		do_swap_map_cluster(vmf, entry);
+
 	if (vmf->flags & FAULT_FLAG_WRITE) {
 		ret |= do_wp_page(vmf);
 		if (ret & VM_FAULT_ERROR)
@@ -3737,7 +3864,7 @@ static int do_numa_page(struct vm_fault *vmf)
 	int page_nid = -1;
 	int last_cpupid;
 	int target_nid;
-	bool migrated = false;
+	int migrated;
 	pte_t pte;
 	bool was_writable = pte_savedwrite(vmf->orig_pte);
 	int flags = 0;
@@ -3800,14 +3927,28 @@ static int do_numa_page(struct vm_fault *vmf)
 	page_nid = page_to_nid(page);
 	target_nid = numa_migrate_prep(page, vma, vmf->address, page_nid,
 			&flags);
+	/*
+	 * A page used again right after its demotion goes back to the fast
+	 * tier now, unless the policy does not allow the node at all.
+	 */
+	if (page_tier_refault(page) && target_nid == -1 &&
+	    READ_ONCE(NODE_DATA(numa_node_id())->promote_reserve) &&
+	    mpol_node_allowed(vma, vmf->address, numa_node_id()))
+		target_nid = numa_node_id();
 	pte_unmap_unlock(vmf->pte, vmf->ptl);
 	if (target_nid == -1) {
 		put_page(page);
 		goto out;
 	}
 
-	/* Migrate to the requested node */
-	migrated = migrate_misplaced_page(page, vma, target_nid);
+	/*
+	 * Queue the page for migration to the requested node. The batch is
+	 * migrated by a worker, which reports back through the next
+	 * task_numa_fault(); until then the page is still on page_nid.
+	 */
+	migrated = queue_misplaced_page(page, vma, target_nid, current);
+	if (migrated == -EINPROGRESS)
+		goto out;
 	if (migrated) {
 		page_nid = target_nid;
 		flags |= TNF_MIGRATED;
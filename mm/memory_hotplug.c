@@ -1360,7 +1360,12 @@ static struct page *new_node_page(struct page *page, unsigned long private)
 	return new_page_nodemask(page, nid, &nmask);
 }
 
-#define NR_OFFLINE_AT_ONCE_PAGES	(256)
+/*
+ * The concurrent migration path unmaps, flushes TLBs and copies a whole
+ * batch at once, with the copy split over several threads, so it pays to
+ * hand it more pages per call.
+ */
+#define NR_OFFLINE_AT_ONCE_PAGES	(512)
 static int
 do_migrate_range(unsigned long start_pfn, unsigned long end_pfn)
 {
@@ -1429,9 +1434,14 @@ do_migrate_range(unsigned long start_pfn, unsigned long end_pfn)
 			goto out;
 		}
 
-		/* Allocate a new page from the nearest neighbor node */
-		ret = migrate_pages(&source, new_node_page, NULL, 0,
-					MIGRATE_SYNC, MR_MEMORY_HOTPLUG);
+		/*
+		 * Allocate a new page from the nearest neighbor node. Pages
+		 * the concurrent path cannot handle (hugetlb, non-lru movable
+		 * and most file-backed pages) fall back to migrate_pages().
+		 */
+		ret = migrate_pages_concur(&source, new_node_page, NULL, 0,
+					MIGRATE_SYNC | MIGRATE_MT | MIGRATE_CONCUR,
+					MR_MEMORY_HOTPLUG);
 		if (ret)
 			putback_movable_pages(&source);
 	}
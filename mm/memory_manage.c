@@ -7,9 +7,12 @@
 #include <linux/memcontrol.h>
 #include <linux/mempolicy.h>
 #include <linux/migrate.h>
+#include <linux/module.h>
 #include <linux/exchange.h>
+#include <linux/ksm.h>
 #include <linux/mm_inline.h>
 #include <linux/nodemask.h>
+#include <linux/page_age.h>
 #include <linux/rmap.h>
 #include <linux/security.h>
 #include <linux/syscalls.h>
@@ -17,6 +20,22 @@
 #include "internal.h"
 
 int migration_batch_size = 16;
+extern unsigned int limit_mt_num;
+
+/* Most pages SHRINK_LISTS ages per node in one call */
+static unsigned long shrink_lists_scan_budget = 1UL << (30 - PAGE_SHIFT);
+/* Pages isolated and aged together under one lru_lock round trip */
+#define AGE_PAGES_BATCH		(32 * SWAP_CLUSTER_MAX)
+/* Below this many pages the workers cost more than they save */
+#define AGE_PAGES_MT_MIN	SWAP_CLUSTER_MAX
+
+/*
+ * A page moved between nodes is not moved again by mm_manage for this
+ * long, so pages near the hot/cold boundary do not ping-pong every
+ * period. 0 disables it. Needs page_age=on to keep migration history.
+ */
+static unsigned int migrate_hysteresis_ms = 1000;
+module_param_named(migrate_hysteresis_ms, migrate_hysteresis_ms, uint, 0644);
 
 enum isolate_action {
 	ISOLATE_COLD_PAGES = 1,
@@ -31,18 +50,22 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 		unsigned long *nr_scanned,
 		unsigned long *nr_taken_base_page,
 		unsigned long *nr_taken_huge_page,
-		isolate_mode_t mode, enum lru_list lru)
+		isolate_mode_t mode, enum lru_list lru,
+		unsigned int min_age, unsigned int max_age,
+		unsigned long migrate_window, unsigned long *nr_suppressed)
 {
 	struct list_head *src = &lruvec->lists[lru];
 	unsigned long nr_taken = 0;
 	unsigned long nr_zone_taken[MAX_NR_ZONES] = { 0 };
-	unsigned long scan, total_scan, nr_pages;
+	unsigned long scan, total_scan, nr_pages, nr_skipped = 0;
 	LIST_HEAD(busy_list);
 	LIST_HEAD(odd_list);
+	LIST_HEAD(skipped_list);
 
 	scan = 0;
 	for (total_scan = 0;
-	     scan < nr_to_scan && nr_taken < nr_to_scan && !list_empty(src);
+	     scan < nr_to_scan && nr_taken < nr_to_scan &&
+	     nr_skipped < nr_to_scan && !list_empty(src);
 	     total_scan++) {
 		struct page *page;
 
@@ -55,9 +78,27 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 		 * Do not count skipped pages because that makes the function
 		 * return with no isolated pages if the LRU mostly contains
 		 * ineligible pages.  This causes the VM to not reclaim any
-		 * pages, triggering a premature OOM.
+		 * pages, triggering a premature OOM. They are bounded by
+		 * nr_skipped instead, and rotated to the head of the list so
+		 * the next walk starts with pages not seen yet.
 		 */
+		if (page_age(page) < min_age || page_age(page) > max_age) {
+			list_move(&page->lru, &skipped_list);
+			nr_skipped++;
+			continue;
+		}
+
+		/* Moved too recently, it would likely just come back */
+		if (page_migrated_within(page, migrate_window)) {
+			list_move(&page->lru, &skipped_list);
+			nr_skipped++;
+			if (nr_suppressed)
+				*nr_suppressed += hpage_nr_pages(page);
+			continue;
+		}
+
 		scan++;
+
 		switch (__isolate_lru_page(page, mode)) {
 		case 0:
 			nr_pages = hpage_nr_pages(page);
@@ -86,6 +127,7 @@ static unsigned long isolate_lru_pages(unsigned long nr_to_scan,
 	}
 	if (!list_empty(&busy_list))
 		list_splice(&busy_list, src);
+	list_splice(&skipped_list, src);
 
 	list_splice_tail(&odd_list, dst_huge_page);
 
@@ -100,47 +142,142 @@ static unsigned long isolate_pages_from_lru_list(pg_data_t *pgdat,
 		struct list_head *huge_page_list,
 		unsigned long *nr_taken_base_page,
 		unsigned long *nr_taken_huge_page,
-		enum isolate_action action)
+		enum isolate_action action, unsigned long *nr_suppressed)
 {
 	struct lruvec *lruvec = mem_cgroup_lruvec(pgdat, memcg);
+	unsigned long migrate_window = 0;
 	enum lru_list lru;
 	unsigned long nr_all_taken = 0;
+	unsigned int min_age = 0, max_age = PAGE_AGE_MAX;
+	int pass, nr_passes = 1;
 
 	pr_debug("isolate %lu pages directly from lru lists\n", nr_pages);
 
 	if (nr_pages == ULONG_MAX)
 		nr_pages = memcg_size_node(memcg, pgdat->node_id);
 
-	for_each_evictable_lru(lru) {
-		unsigned long nr_scanned, nr_taken;
-		int file = is_file_lru(lru);
+	if (nr_suppressed)
+		migrate_window =
+			msecs_to_jiffies(READ_ONCE(migrate_hysteresis_ms));
 
-		if (action == ISOLATE_COLD_PAGES && is_active_lru(lru))
-			continue;
-		if (action == ISOLATE_HOT_PAGES && !is_active_lru(lru))
-			continue;
+	/*
+	 * With page ages, hot pages are taken youngest generation first and
+	 * cold pages oldest generation first, one generation per pass, so
+	 * every page is looked at in one pass only. The youngest generation
+	 * is not demoted and the oldest is not promoted, unless those passes
+	 * found nothing: aging may not have reached this lruvec yet, and new
+	 * or just migrated pages are all young. Then one more pass takes
+	 * pages of any age.
+	 */
+	if (page_age_started() && action != ISOLATE_HOT_AND_COLD_PAGES)
+		nr_passes = PAGE_AGE_MAX;
+
+	for (pass = 0; pass <= nr_passes && nr_all_taken <= nr_pages; pass++) {
+		if (pass == nr_passes) {
+			if (nr_passes == 1 || nr_all_taken)
+				break;
+			min_age = 0;
+			max_age = PAGE_AGE_MAX;
+		} else if (nr_passes > 1) {
+			if (action == ISOLATE_HOT_PAGES)
+				min_age = max_age = pass;
+			else
+				min_age = max_age = PAGE_AGE_MAX - pass;
+		}
 
-		spin_lock_irq(&pgdat->lru_lock);
+		for_each_evictable_lru(lru) {
+			unsigned long nr_scanned, nr_taken;
+			int file = is_file_lru(lru);
 
-		nr_taken = isolate_lru_pages(nr_pages, lruvec, base_page_list,
-					huge_page_list, &nr_scanned,
-					nr_taken_base_page,
-					nr_taken_huge_page,
-					0, lru);
+			if (action == ISOLATE_COLD_PAGES && is_active_lru(lru))
+				continue;
+			if (action == ISOLATE_HOT_PAGES && !is_active_lru(lru))
+				continue;
 
-		__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, nr_taken);
+			spin_lock_irq(&pgdat->lru_lock);
 
-		spin_unlock_irq(&pgdat->lru_lock);
+			nr_taken = isolate_lru_pages(nr_pages, lruvec,
+						base_page_list, huge_page_list,
+						&nr_scanned, nr_taken_base_page,
+						nr_taken_huge_page, 0, lru,
+						min_age, max_age, migrate_window,
+						nr_suppressed);
 
-		nr_all_taken += nr_taken;
+			__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file,
+					      nr_taken);
 
-		if (nr_all_taken > nr_pages)
-			break;
+			spin_unlock_irq(&pgdat->lru_lock);
+
+			nr_all_taken += nr_taken;
+
+			if (nr_all_taken > nr_pages)
+				break;
+		}
 	}
 
 	return nr_all_taken;
 }
 
+/*
+ * A ksm page sits on the LRU of the memcg it was first charged to, but is
+ * mapped by mms of other memcgs as well: keep it where it is while the
+ * aggregate heat of all its sharers says it is still in use.
+ */
+static unsigned long putback_hot_ksm_pages(struct list_head *page_list)
+{
+	unsigned long nr_pages = 0;
+	struct page *page, *next;
+
+	list_for_each_entry_safe(page, next, page_list, lru) {
+		if (!PageKsm(page) || !ksm_page_hot(page))
+			continue;
+
+		list_del(&page->lru);
+		dec_node_page_state(page, NR_ISOLATED_ANON +
+				page_is_file_cache(page));
+		SetPageActive(page);
+		putback_lru_page(page);
+		nr_pages++;
+	}
+
+	return nr_pages;
+}
+
+/*
+ * Put back the pages that a madvise tier hint keeps where they are:
+ * VM_TIER_FAST pages are not demoted, VM_TIER_SLOW pages not promoted.
+ * Returns the number of base pages put back.
+ */
+static unsigned long putback_tier_hinted_pages(struct list_head *page_list,
+		unsigned long vm_flag)
+{
+	unsigned long nr_pages = 0;
+	struct page *page, *next;
+
+	if (!READ_ONCE(vma_tier_hints_used))
+		return 0;
+
+	list_for_each_entry_safe(page, next, page_list, lru) {
+		if (!(page_tier_hint(page) & vm_flag))
+			continue;
+
+		list_del(&page->lru);
+		mod_node_page_state(page_pgdat(page), NR_ISOLATED_ANON +
+				page_is_file_cache(page), -hpage_nr_pages(page));
+		nr_pages += hpage_nr_pages(page);
+		putback_lru_page(page);
+	}
+
+	return nr_pages;
+}
+
+/* Sum the references of every sharer for ksm pages, not just this memcg's */
+static inline int page_referenced_tier(struct page *page,
+		struct mem_cgroup *memcg, unsigned long *vm_flags)
+{
+	return page_referenced(page, 0, PageKsm(page) ? NULL : memcg, vm_flags);
+}
+
 static int migrate_to_node(struct list_head *page_list, int nid,
 		enum migrate_mode mode, int batch_size)
 {
@@ -308,14 +445,14 @@ static int add_pages_to_exchange_list(struct list_head *from_pagelist,
 			continue;
 		}
 
-		/* Exclude file-backed pages, exchange it concurrently is not
-		 * implemented yet. */
-		if (page_mapping(from_page)) {
+		/* Exclude file-backed pages other than shmem and swap cache
+		 * pages, exchange them concurrently is not implemented yet. */
+		if (!page_mapping_concur_movable(from_page)) {
 			list_del(&from_page->lru);
 			list_add(&from_page->lru, &odd_from_list);
 			continue;
 		}
-		if (page_mapping(to_page)) {
+		if (!page_mapping_concur_movable(to_page)) {
 			list_del(&to_page->lru);
 			list_add(&to_page->lru, &odd_to_list);
 			continue;
@@ -398,6 +535,54 @@ static unsigned long exchange_pages_between_nodes(unsigned long nr_from_pages,
 	return info_list_size;
 }
 
+/*
+ * Swap sits below the slowest node when the memcg enables swap.tier: once
+ * @nid holds more than its max_at_node limit, the coldest overflow pages are
+ * reclaimed to swap instead of staying resident. Returns the number of base
+ * pages reclaimed.
+ */
+static unsigned long demote_overflow_pages_to_swap(struct mem_cgroup *memcg,
+		int nid)
+{
+	unsigned long max_nr_pages = memcg_max_size_node(memcg, nid);
+	unsigned long nr_pages = memcg_size_node(memcg, nid);
+	unsigned long nr_isolated_base_pages = 0, nr_isolated_huge_pages = 0;
+	unsigned long nr_reclaimed;
+	struct page *page, *next;
+	LIST_HEAD(base_page_list);
+	LIST_HEAD(huge_page_list);
+
+	if (!memcg_swap_tier_enabled(memcg) || nr_pages <= max_nr_pages)
+		return 0;
+
+	if (!isolate_pages_from_lru_list(NODE_DATA(nid), memcg,
+			nr_pages - max_nr_pages, &base_page_list, &huge_page_list,
+			&nr_isolated_base_pages, &nr_isolated_huge_pages,
+			ISOLATE_COLD_PAGES, NULL))
+		return 0;
+
+	putback_hot_ksm_pages(&base_page_list);
+	putback_tier_hinted_pages(&base_page_list, VM_TIER_FAST);
+	putback_tier_hinted_pages(&huge_page_list, VM_TIER_FAST);
+	list_splice_init(&huge_page_list, &base_page_list);
+
+	list_for_each_entry(page, &base_page_list, lru)
+		mod_node_page_state(page_pgdat(page),
+				NR_ISOLATED_ANON + page_is_file_cache(page),
+				-hpage_nr_pages(page));
+
+	nr_reclaimed = reclaim_pages_from_list(NODE_DATA(nid), &base_page_list);
+
+	list_for_each_entry_safe(page, next, &base_page_list, lru) {
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+
+	pr_debug("%lu pages demoted to swap from node: %d\n", nr_reclaimed, nid);
+
+	return nr_reclaimed;
+}
+
 static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 		const nodemask_t *from, const nodemask_t *to,
 		unsigned long nr_pages, int flags)
@@ -419,7 +604,9 @@ static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 				  nr_isolated_to_huge_pages = ULONG_MAX;
 	unsigned long max_nr_pages_to_node, nr_pages_to_node, nr_active_pages_from_node;
 	unsigned long nr_pages_from_node;
+	unsigned long nr_suppressed = 0;
 	long nr_free_pages_to_node;
+	unsigned int promote_flags;
 	int from_nid, to_nid;
 	enum migrate_mode mode = MIGRATE_SYNC |
 		(migrate_mt ? MIGRATE_MT : MIGRATE_SINGLETHREAD) |
@@ -469,7 +656,14 @@ static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 	nr_isolated_from_pages = isolate_pages_from_lru_list(NODE_DATA(from_nid),
 			memcg, nr_pages, &from_base_page_list, &from_huge_page_list,
 			&nr_isolated_from_base_pages, &nr_isolated_from_huge_pages,
-			from_action);
+			from_action, &nr_suppressed);
+
+	nr_isolated_from_base_pages -=
+		putback_tier_hinted_pages(&from_base_page_list, VM_TIER_SLOW);
+	nr_isolated_from_huge_pages -=
+		putback_tier_hinted_pages(&from_huge_page_list, VM_TIER_SLOW);
+	nr_isolated_from_pages = nr_isolated_from_base_pages +
+		nr_isolated_from_huge_pages;
 
 	pr_debug("%ld pages isolated at from node: %d\n", nr_isolated_from_pages, from_nid);
 
@@ -487,9 +681,22 @@ static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 				nr_isolated_from_pages - nr_free_pages_to_node,
 				&to_base_page_list, &to_huge_page_list,
 				&nr_isolated_to_base_pages, &nr_isolated_to_huge_pages,
-				move_hot_and_cold_pages?ISOLATE_HOT_AND_COLD_PAGES:ISOLATE_COLD_PAGES);
+				move_hot_and_cold_pages?ISOLATE_HOT_AND_COLD_PAGES:ISOLATE_COLD_PAGES,
+				&nr_suppressed);
 		pr_debug("%lu pages isolated at to node: %d\n", nr_isolated_to_pages, to_nid);
 
+		if (!move_hot_and_cold_pages)
+			nr_isolated_to_base_pages -=
+				putback_hot_ksm_pages(&to_base_page_list);
+
+		/* pinned-hot pages are never exchange or demotion victims */
+		nr_isolated_to_base_pages -=
+			putback_tier_hinted_pages(&to_base_page_list,
+						  VM_TIER_FAST);
+		nr_isolated_to_huge_pages -=
+			putback_tier_hinted_pages(&to_huge_page_list,
+						  VM_TIER_FAST);
+
 		if (migrate_exchange_pages) {
 			unsigned long nr_exchange_pages;
 
@@ -582,6 +789,8 @@ static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 		list_empty(&from_huge_page_list)))
 		pr_info("%ld free pages at to node: %d\n", nr_free_pages_to_node, to_nid);
 
+	/* promotions may allocate from the to node's promotion reserve */
+	promote_flags = memalloc_promote_save();
 	if (migrate_mt || migrate_concur) {
 		nr_isolated_from_base_pages -=
 			migrate_to_node(&from_base_page_list, to_nid, mode & ~MIGRATE_MT,
@@ -605,41 +814,30 @@ static int do_mm_manage(struct task_struct *p, struct mm_struct *mm,
 			migrate_to_node(&from_base_page_list, to_nid, mode);
 #endif
 	}
+	memalloc_promote_restore(promote_flags);
 
 	p->page_migration_stats.s2f.nr_migrations += 1;
 	p->page_migration_stats.s2f.nr_base_pages += nr_isolated_from_base_pages;
 	p->page_migration_stats.s2f.nr_huge_pages += nr_isolated_from_huge_pages;
 
+	p->page_migration_stats.nr_swap_tier_pages +=
+		demote_overflow_pages_to_swap(memcg, from_nid);
+	p->page_migration_stats.nr_pingpong_suppressed += nr_suppressed;
+
 	return err;
 }
 
-static unsigned long shrink_active_list(pg_data_t *pgdat, struct lruvec *lruvec,
-	enum lru_list lru, unsigned long nr_to_scan, bool fast_node)
+static void age_active_pages(struct list_head *page_list,
+	struct mem_cgroup *memcg, struct list_head *l_active,
+	struct list_head *l_inactive)
 {
-	unsigned long nr_scanned = 0, nr_taken = 0, nr_rotated = 0;
-	unsigned long nr_activate, nr_deactivate;
-	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
 	unsigned long vm_flags;
 	struct page *page;
-	int file = is_file_lru(lru);
-	LIST_HEAD(l_hold);
-	LIST_HEAD(l_active);
-	LIST_HEAD(l_inactive);
-
-	lru_add_drain();
-
-	spin_lock_irq(&pgdat->lru_lock);
-
-	nr_taken = isolate_lru_pages(nr_to_scan, lruvec, &l_hold, &l_hold,
-				     &nr_scanned, &nr_taken, &nr_taken, 0, lru);
-
-	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, nr_taken);
+	int referenced;
 
-	spin_unlock_irq(&pgdat->lru_lock);
-
-	while (!list_empty(&l_hold)) {
+	while (!list_empty(page_list)) {
 		cond_resched();
-		page = lru_to_page(&l_hold);
+		page = lru_to_page(page_list);
 		list_del(&page->lru);
 
 		if (unlikely(!page_evictable(page))) {
@@ -647,9 +845,14 @@ static unsigned long shrink_active_list(pg_data_t *pgdat, struct lruvec *lruvec,
 			continue;
 		}
 
-		if (page_referenced(page, 0, memcg,
-				    &vm_flags)) {
-			nr_rotated += hpage_nr_pages(page);
+		referenced = page_referenced_tier(page, memcg, &vm_flags);
+		page_age_update(page, referenced);
+		if (referenced) {
+			/* Recently demoted and used again: promote it back */
+			if (page_tier_refault(page)) {
+				list_add(&page->lru, l_active);
+				continue;
+			}
 			/*
 			 * Identify referenced, file-backed active pages and
 			 * give them one more trip around the active list. So
@@ -660,109 +863,229 @@ static unsigned long shrink_active_list(pg_data_t *pgdat, struct lruvec *lruvec,
 			 * so we ignore them here.
 			 */
 			if ((vm_flags & VM_EXEC) && page_is_file_cache(page)) {
-				list_add(&page->lru, &l_active);
+				list_add(&page->lru, l_active);
 				continue;
 			}
 		}
 
 		ClearPageActive(page);	/* we are de-activating */
-		list_add(&page->lru, &l_inactive);
+		list_add(&page->lru, l_inactive);
 	}
-
-	/*
-	 * Move pages back to the lru list.
-	 */
-	spin_lock_irq(&pgdat->lru_lock);
-
-	nr_activate = move_active_pages_to_lru(lruvec, &l_active, &l_hold, lru);
-	nr_deactivate = move_active_pages_to_lru(lruvec, &l_inactive, &l_hold, lru - LRU_ACTIVE);
-	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, -nr_taken);
-	spin_unlock_irq(&pgdat->lru_lock);
-
-	mem_cgroup_uncharge_list(&l_hold);
-	free_hot_cold_page_list(&l_hold, true);
-
-	return 0;
 }
 
-static unsigned long shrink_inactive_page_list(struct list_head *page_list,
-	pg_data_t *pgdat, struct lruvec *lruvec, enum lru_list lru,
-	struct mem_cgroup *memcg, unsigned long nr_taken)
+static void age_inactive_pages(struct list_head *page_list,
+	struct mem_cgroup *memcg, struct list_head *l_active,
+	struct list_head *l_inactive)
 {
-	unsigned long nr_activate, nr_deactivate;
-	int file = is_file_lru(lru);
-	LIST_HEAD(l_active);
-	LIST_HEAD(l_inactive);
-	LIST_HEAD(l_hold);
-
 	while (!list_empty(page_list)) {
 		struct page *page;
 		int referenced_ptes, referenced_page;
 		unsigned long vm_flags;
 
+		cond_resched();
 		page = list_first_entry(page_list, struct page, lru);
 		list_del(&page->lru);
 
-		referenced_ptes = page_referenced(page, 0, memcg, &vm_flags);
+		referenced_ptes = page_referenced_tier(page, memcg, &vm_flags);
 		referenced_page = TestClearPageReferenced(page);
+		page_age_update(page, referenced_ptes || referenced_page);
 
 		if (referenced_ptes) {
 			SetPageReferenced(page);
 
-			if (referenced_page || referenced_ptes > 1) {
+			if (page_tier_refault(page) || referenced_page ||
+			    referenced_ptes > 1) {
 				SetPageActive(page);
-				list_add(&page->lru, &l_active);
+				list_add(&page->lru, l_active);
 				continue;
 			}
 
 			if (vm_flags & VM_EXEC) {
 				SetPageActive(page);
-				list_add(&page->lru, &l_active);
+				list_add(&page->lru, l_active);
 				continue;
 			}
 		}
-		list_add(&page->lru, &l_inactive);
+		list_add(&page->lru, l_inactive);
 	}
+}
+
+struct age_pages_work {
+	struct work_struct work;
+	struct mem_cgroup *memcg;
+	bool active;
+	struct list_head page_list;
+	struct list_head l_active;
+	struct list_head l_inactive;
+};
+
+static void age_pages_work_thread(struct work_struct *work)
+{
+	struct age_pages_work *my_work = (struct age_pages_work *)work;
+
+	if (my_work->active)
+		age_active_pages(&my_work->page_list, my_work->memcg,
+			&my_work->l_active, &my_work->l_inactive);
+	else
+		age_inactive_pages(&my_work->page_list, my_work->memcg,
+			&my_work->l_active, &my_work->l_inactive);
+}
+
+/*
+ * Sort isolated pages into l_active and l_inactive by their references.
+ * The rmap walks are split among up to limit_mt_num workers on the CPUs of
+ * the pages' node; each worker sorts into private lists which are merged
+ * here, so the caller can put everything back under one lru_lock.
+ */
+static void age_pages(pg_data_t *pgdat, struct mem_cgroup *memcg,
+	bool active, struct list_head *page_list, unsigned long nr_pages,
+	struct list_head *l_active, struct list_head *l_inactive)
+{
+	const struct cpumask *per_node_cpumask = cpumask_of_node(pgdat->node_id);
+	unsigned int total_mt_num = limit_mt_num;
+	struct age_pages_work *work_items = NULL;
+	unsigned long nr_per_work;
+	int i, cpu;
+
+	total_mt_num = min_t(unsigned int, total_mt_num,
+						 cpumask_weight(per_node_cpumask));
+	if (nr_pages < AGE_PAGES_MT_MIN)
+		total_mt_num = 1;
+
+	if (total_mt_num > 1)
+		work_items = kcalloc(total_mt_num, sizeof(*work_items), GFP_KERNEL);
+
+	if (!work_items) {
+		if (active)
+			age_active_pages(page_list, memcg, l_active, l_inactive);
+		else
+			age_inactive_pages(page_list, memcg, l_active, l_inactive);
+		return;
+	}
+
+	nr_per_work = DIV_ROUND_UP(nr_pages, total_mt_num);
+
+	i = 0;
+	for_each_cpu(cpu, per_node_cpumask) {
+		unsigned long nr;
+
+		if (i >= total_mt_num)
+			break;
+		INIT_WORK((struct work_struct *)&work_items[i],
+				  age_pages_work_thread);
+		work_items[i].memcg = memcg;
+		work_items[i].active = active;
+		INIT_LIST_HEAD(&work_items[i].page_list);
+		INIT_LIST_HEAD(&work_items[i].l_active);
+		INIT_LIST_HEAD(&work_items[i].l_inactive);
+		for (nr = 0; nr < nr_per_work && !list_empty(page_list);) {
+			struct page *page = lru_to_page(page_list);
+
+			nr += hpage_nr_pages(page);
+			list_move(&page->lru, &work_items[i].page_list);
+		}
+
+		queue_work_on(cpu, system_highpri_wq,
+					  (struct work_struct *)&work_items[i]);
+		++i;
+	}
+
+	/* anything left over, e.g. after a CPU went away, is aged here */
+	if (active)
+		age_active_pages(page_list, memcg, l_active, l_inactive);
+	else
+		age_inactive_pages(page_list, memcg, l_active, l_inactive);
+
+	/* Wait until it finishes  */
+	while (--i >= 0) {
+		flush_work((struct work_struct *)&work_items[i]);
+		list_splice(&work_items[i].l_active, l_active);
+		list_splice(&work_items[i].l_inactive, l_inactive);
+	}
+
+	kfree(work_items);
+}
+
+static unsigned long shrink_active_list(pg_data_t *pgdat, struct lruvec *lruvec,
+	enum lru_list lru, unsigned long nr_to_scan, bool fast_node)
+{
+	unsigned long nr_scanned = 0, nr_taken = 0;
+	unsigned long nr_activate, nr_deactivate;
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+	int file = is_file_lru(lru);
+	LIST_HEAD(l_hold);
+	LIST_HEAD(l_active);
+	LIST_HEAD(l_inactive);
+
+	lru_add_drain();
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	nr_taken = isolate_lru_pages(nr_to_scan, lruvec, &l_hold, &l_hold,
+				     &nr_scanned, &nr_taken, &nr_taken, 0, lru,
+				     0, PAGE_AGE_MAX, 0, NULL);
+
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, nr_taken);
+
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	age_pages(pgdat, memcg, true, &l_hold, nr_taken, &l_active, &l_inactive);
+
 	/*
 	 * Move pages back to the lru list.
 	 */
 	spin_lock_irq(&pgdat->lru_lock);
 
-	nr_activate = move_active_pages_to_lru(lruvec, &l_active, &l_hold, lru + LRU_ACTIVE);
-	nr_deactivate = move_active_pages_to_lru(lruvec, &l_inactive, &l_hold, lru);
+	nr_activate = move_active_pages_to_lru(lruvec, &l_active, &l_hold, lru);
+	nr_deactivate = move_active_pages_to_lru(lruvec, &l_inactive, &l_hold, lru - LRU_ACTIVE);
 	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, -nr_taken);
 	spin_unlock_irq(&pgdat->lru_lock);
 
-	list_splice(&l_hold, page_list);
+	mem_cgroup_uncharge_list(&l_hold);
+	free_hot_cold_page_list(&l_hold, true);
 
-	return 0;
+	return nr_scanned;
 }
 
 static unsigned long shrink_inactive_list(pg_data_t *pgdat, struct lruvec *lruvec,
 	enum lru_list lru, unsigned long nr_to_scan, bool fast_node)
 {
-	unsigned long nr_scanned = 0, nr_taken = 0, nr_rotated;
+	unsigned long nr_scanned = 0, nr_taken = 0;
+	unsigned long nr_activate, nr_deactivate;
 	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
 	int file = is_file_lru(lru);
 	LIST_HEAD(page_list);
+	LIST_HEAD(l_active);
+	LIST_HEAD(l_inactive);
 
 	lru_add_drain();
 
 	spin_lock_irq(&pgdat->lru_lock);
 
 	nr_taken = isolate_lru_pages(nr_to_scan, lruvec, &page_list, &page_list,
-			&nr_scanned, &nr_taken, &nr_taken, 0, lru);
+			&nr_scanned, &nr_taken, &nr_taken, 0, lru,
+			0, PAGE_AGE_MAX, 0, NULL);
 
 	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, nr_taken);
 
 	spin_unlock_irq(&pgdat->lru_lock);
 
-	nr_rotated = shrink_inactive_page_list(&page_list, pgdat, lruvec, lru, memcg,
-			nr_taken);
+	age_pages(pgdat, memcg, false, &page_list, nr_taken, &l_active,
+		&l_inactive);
+
+	/*
+	 * Move pages back to the lru list.
+	 */
+	spin_lock_irq(&pgdat->lru_lock);
+
+	nr_activate = move_active_pages_to_lru(lruvec, &l_active, &page_list, lru + LRU_ACTIVE);
+	nr_deactivate = move_active_pages_to_lru(lruvec, &l_inactive, &page_list, lru);
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, -nr_taken);
+	spin_unlock_irq(&pgdat->lru_lock);
 
 	mem_cgroup_uncharge_list(&page_list);
 	free_hot_cold_page_list(&page_list, true);
-	return 0;
+	return nr_scanned;
 }
 
 static unsigned long shrink_lists_node_memcg(pg_data_t *pgdat,
@@ -770,12 +1093,24 @@ static unsigned long shrink_lists_node_memcg(pg_data_t *pgdat,
 	bool fast_node)
 {
 	struct lruvec *lruvec = mem_cgroup_lruvec(pgdat, memcg);
-	unsigned long nr_rotated_active = 0, nr_rotated_inactive = 0;
+	unsigned long nr_lru_pages = 0, nr_scanned = 0;
 	enum lru_list lru;
 
+	for_each_evictable_lru(lru)
+		nr_lru_pages += lruvec_size_memcg_node(lru, memcg,
+				pgdat->node_id);
+	if (!nr_lru_pages)
+		return 0;
+
 	for_each_evictable_lru(lru) {
-		unsigned long nr_to_scan_local = lruvec_size_memcg_node(lru, memcg,
-				pgdat->node_id) / 2;
+		unsigned long nr_lru = lruvec_size_memcg_node(lru, memcg,
+				pgdat->node_id);
+		/*
+		 * Scan at most half of each list, and split the budget among
+		 * the lists by their size.
+		 */
+		unsigned long nr_to_scan_local = min_t(unsigned long, nr_lru / 2,
+				div64_u64((u64)nr_to_scan * nr_lru, nr_lru_pages));
 		/*nr_reclaimed += shrink_list(lru, nr_to_scan, lruvec, memcg, sc);*/
 		/*
 		 * for from(slow) node, we want active list, we start from the top of
@@ -790,23 +1125,55 @@ static unsigned long shrink_lists_node_memcg(pg_data_t *pgdat,
 		 * A key question is how many pages to scan each time, and what criteria
 		 * to use to move pages between active/inactive page lists.
 		 *  */
-		if (is_active_lru(lru))
-			nr_rotated_active += shrink_active_list(pgdat, lruvec, lru,
-				nr_to_scan_local, fast_node);
-		else
-			nr_rotated_inactive += shrink_inactive_list(pgdat, lruvec, lru,
-				nr_to_scan_local, fast_node);
+		while (nr_to_scan_local) {
+			unsigned long nr_batch = min_t(unsigned long,
+					nr_to_scan_local, AGE_PAGES_BATCH);
+			unsigned long nr;
+
+			if (is_active_lru(lru))
+				nr = shrink_active_list(pgdat, lruvec, lru,
+					nr_batch, fast_node);
+			else
+				nr = shrink_inactive_list(pgdat, lruvec, lru,
+					nr_batch, fast_node);
+			if (!nr)
+				break;
+			nr_scanned += nr;
+			nr_to_scan_local -= min(nr, nr_to_scan_local);
+			cond_resched();
+		}
 	}
-	cond_resched();
 
-	return 0;
+	return nr_scanned;
+}
+
+struct shrink_lists_work {
+	struct work_struct work;
+	pg_data_t *pgdat;
+	struct mem_cgroup *memcg;
+	unsigned long nr_to_scan;
+	bool fast_node;
+};
+
+static void shrink_lists_work_thread(struct work_struct *work)
+{
+	struct shrink_lists_work *my_work = (struct shrink_lists_work *)work;
+
+	shrink_lists_node_memcg(my_work->pgdat, my_work->memcg,
+			my_work->nr_to_scan, my_work->fast_node);
 }
 
+/*
+ * Age the from (slow) and the to (fast) node at the same time: the to node
+ * is aged by a worker on one of its own CPUs while this task ages the from
+ * node. The to node is aged here too if it has no online CPU.
+ */
 static int shrink_lists(struct task_struct *p, struct mm_struct *mm,
 		const nodemask_t *from, const nodemask_t *to, unsigned long nr_to_scan)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_task(p);
-	int from_nid, to_nid;
+	struct shrink_lists_work to_work;
+	int from_nid, to_nid, cpu;
 	int err = 0;
 
 	VM_BUG_ON(!memcg);
@@ -819,9 +1186,30 @@ static int shrink_lists(struct task_struct *p, struct mm_struct *mm,
 	from_nid = first_node(*from);
 	to_nid = first_node(*to);
 
+	/* bound the work of a single call, whatever nr_to_scan asks for */
+	if (!nr_to_scan || nr_to_scan > shrink_lists_scan_budget)
+		nr_to_scan = shrink_lists_scan_budget;
+
+	cpu = cpumask_any_and(cpumask_of_node(to_nid), cpu_online_mask);
+	if (to_nid == from_nid || cpu >= nr_cpu_ids) {
+		shrink_lists_node_memcg(NODE_DATA(from_nid), memcg,
+				nr_to_scan, false);
+		shrink_lists_node_memcg(NODE_DATA(to_nid), memcg,
+				nr_to_scan, true);
+		return err;
+	}
+
+	INIT_WORK_ONSTACK(&to_work.work, shrink_lists_work_thread);
+	to_work.pgdat = NODE_DATA(to_nid);
+	to_work.memcg = memcg;
+	to_work.nr_to_scan = nr_to_scan;
+	to_work.fast_node = true;
+	queue_work_on(cpu, system_highpri_wq, &to_work.work);
+
 	shrink_lists_node_memcg(NODE_DATA(from_nid), memcg, nr_to_scan, false);
 
-	shrink_lists_node_memcg(NODE_DATA(to_nid), memcg, nr_to_scan, true);
+	flush_work(&to_work.work);
+	destroy_work_on_stack(&to_work.work);
 
 	return err;
 }
@@ -912,8 +1300,13 @@ SYSCALL_DEFINE6(mm_manage, pid_t, pid, unsigned long, nr_pages,
 		set_bit(MMF_MM_MANAGE, &mm->flags);
 	}
 
+	/*
+	 * With MPOL_MF_MOVE, nr_pages is the number of pages to migrate and
+	 * says nothing about how much to age: use the full scan budget.
+	 */
 	if (flags & MPOL_MF_SHRINK_LISTS)
-		shrink_lists(task, mm, old, new, nr_pages);
+		shrink_lists(task, mm, old, new,
+			     (flags & MPOL_MF_MOVE) ? 0 : nr_pages);
 
 	if (flags & MPOL_MF_MOVE)
 		err = do_mm_manage(task, mm, old, new, nr_pages, flags);
@@ -559,6 +559,23 @@ unsigned long change_prot_numa(struct vm_area_struct *vma,
 
 	return nr_updated;
 }
+
+/*
+ * Same as change_prot_numa(), but pages already on the local node are left
+ * alone: the return value is the number of slow-tier resident pages marked.
+ */
+unsigned long change_prot_numa_tier(struct vm_area_struct *vma,
+			unsigned long addr, unsigned long end)
+{
+	int nr_updated;
+
+	nr_updated = change_protection(vma, addr, end, PAGE_NONE, 0,
+				       PROT_NUMA_TIER);
+	if (nr_updated)
+		count_vm_numa_events(NUMA_PTE_UPDATES, nr_updated);
+
+	return nr_updated;
+}
 #else
 static unsigned long change_prot_numa(struct vm_area_struct *vma,
 			unsigned long addr, unsigned long end)
@@ -1982,8 +1999,13 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 			goto use_other_policy;
 		}
 
-		/* skip preferred node if mm_manage is going on */
-		if (test_bit(MMF_MM_MANAGE, &mm->flags)) {
+		/*
+		 * skip preferred node if mm_manage is going on, unless the vma
+		 * asked for the fast tier. MADV_TIER_SLOW vmas always skip it.
+		 */
+		if ((vma && (vma->vm_flags & VM_TIER_SLOW)) ||
+		    (test_bit(MMF_MM_MANAGE, &mm->flags) &&
+		     !(vma && (vma->vm_flags & VM_TIER_FAST)))) {
 			nid = next_memory_node(nid);
 			if (nid == MAX_NUMNODES)
 				nid = first_memory_node;
@@ -2244,6 +2266,27 @@ static void sp_free(struct sp_node *n)
 	kmem_cache_free(sn_cache, n);
 }
 
+/**
+ * mpol_node_allowed - check whether a policy allows allocating on a node
+ * @vma: vm area the page is for
+ * @addr: virtual address the page is for
+ * @nid: the node to check
+ *
+ * For callers that pick the node themselves, such as the tiering code
+ * placing a page on the slow tier. Only MPOL_BIND restricts the nodes, the
+ * other policies merely prefer some.
+ */
+bool mpol_node_allowed(struct vm_area_struct *vma, unsigned long addr,
+		       int nid)
+{
+	struct mempolicy *pol = get_vma_policy(vma, addr);
+	nodemask_t *nmask = policy_nodemask(GFP_HIGHUSER_MOVABLE, pol);
+	bool ret = !nmask || node_isset(nid, *nmask);
+
+	mpol_cond_put(pol);
+	return ret;
+}
+
 /**
  * mpol_misplaced - check whether current page node is valid in policy
  *
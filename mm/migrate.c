@@ -16,6 +16,7 @@
 #include <linux/migrate.h>
 #include <linux/export.h>
 #include <linux/swap.h>
+#include <linux/shmem_fs.h>
 #include <linux/swapops.h>
 #include <linux/pagemap.h>
 #include <linux/buffer_head.h>
@@ -44,8 +45,13 @@
 #include <linux/mmu_notifier.h>
 #include <linux/page_idle.h>
 #include <linux/page_owner.h>
+#include <linux/page_age.h>
 #include <linux/sched/mm.h>
+#include <linux/sched/numa_balancing.h>
+#include <linux/sched/task.h>
 #include <linux/ptrace.h>
+#include <linux/sort.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 
@@ -312,6 +318,176 @@ void remove_migration_ptes(struct page *old, struct page *new, bool locked)
 		rmap_walk(new, &rwc);
 }
 
+struct migration_pte_batch_item {
+	struct page *old;
+	struct page *new;
+	struct anon_vma *anon_vma;
+	pgoff_t pgoff;
+};
+
+static int migration_pte_batch_cmp(const void *a, const void *b)
+{
+	const struct migration_pte_batch_item *l = a, *r = b;
+
+	if (l->anon_vma != r->anon_vma)
+		return l->anon_vma < r->anon_vma ? -1 : 1;
+	if (l->pgoff != r->pgoff)
+		return l->pgoff < r->pgoff ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Restore the migration entries of @nr base pages that are mapped by @vma
+ * into one page table, taking the PTL only once.
+ */
+static void remove_migration_ptes_pmd(struct vm_area_struct *vma,
+		struct migration_pte_batch_item *items, int nr)
+{
+	struct mm_struct *mm = vma->vm_mm;
+	unsigned long address;
+	spinlock_t *ptl;
+	pmd_t *pmd;
+	int i;
+
+	address = vma->vm_start + ((items[0].pgoff - vma->vm_pgoff) << PAGE_SHIFT);
+	pmd = mm_find_pmd(mm, address);
+	if (!pmd)
+		return;
+
+	ptl = pte_lockptr(mm, pmd);
+	spin_lock(ptl);
+	for (i = 0; i < nr; i++) {
+		struct page *new = items[i].new;
+		swp_entry_t entry;
+		pte_t *ptep;
+		pte_t pte;
+
+		address = vma->vm_start +
+			((items[i].pgoff - vma->vm_pgoff) << PAGE_SHIFT);
+		ptep = pte_offset_map(pmd, address);
+
+		if (!is_swap_pte(*ptep))
+			goto next;
+		entry = pte_to_swp_entry(*ptep);
+		if (!is_migration_entry(entry) ||
+		    swp_offset(entry) != page_to_pfn(items[i].old))
+			goto next;
+
+		get_page(new);
+		pte = pte_mkold(mk_pte(new, READ_ONCE(vma->vm_page_prot)));
+		if (pte_swp_soft_dirty(*ptep))
+			pte = pte_mksoft_dirty(pte);
+
+		/*
+		 * Recheck VMA as permissions can change since migration started
+		 */
+		if (is_write_migration_entry(entry))
+			pte = maybe_mkwrite(pte, vma);
+
+		flush_dcache_page(new);
+		set_pte_at(mm, address, ptep, pte);
+		page_add_anon_rmap(new, vma, address, false);
+
+		if (vma->vm_flags & VM_LOCKED)
+			mlock_vma_page(new);
+
+		/* No need to invalidate - it was non-present before */
+		update_mmu_cache(vma, address, ptep);
+next:
+		pte_unmap(ptep);
+	}
+	spin_unlock(ptl);
+}
+
+/*
+ * Batched remove_migration_ptes() for the concurrent migration and
+ * exchange paths.
+ *
+ * Anonymous base pages are grouped by anon_vma, so that the anon_vma lock
+ * is taken and its interval tree is walked once per group. Within each VMA,
+ * all migration entries that live in the same page table are restored
+ * under one PTL acquisition. THPs, KSM, hugetlb, device and file-backed
+ * pages go through remove_migration_ptes() one by one.
+ *
+ * The caller holds both pages of each pair locked and a reference on
+ * their anon_vma.
+ */
+void remove_migration_ptes_batch(struct page **old, struct page **new, int nr)
+{
+	struct migration_pte_batch_item *items;
+	int i, nr_items = 0, start, end;
+
+	items = kmalloc_array(nr, sizeof(*items), GFP_KERNEL);
+
+	for (i = 0; i < nr; i++) {
+		struct anon_vma *anon_vma = page_anon_vma(new[i]);
+
+		if (!items || !anon_vma || PageCompound(new[i]) ||
+		    is_zone_device_page(new[i])) {
+			remove_migration_ptes(old[i], new[i], false);
+			continue;
+		}
+
+		items[nr_items].old = old[i];
+		items[nr_items].new = new[i];
+		items[nr_items].anon_vma = anon_vma;
+		items[nr_items].pgoff = page_to_pgoff(new[i]);
+		nr_items++;
+	}
+
+	if (!nr_items)
+		goto out;
+
+	sort(items, nr_items, sizeof(*items), migration_pte_batch_cmp, NULL);
+
+	for (start = 0; start < nr_items; start = end) {
+		struct anon_vma *anon_vma = items[start].anon_vma;
+		struct anon_vma_chain *avc;
+
+		end = start + 1;
+		while (end < nr_items && items[end].anon_vma == anon_vma)
+			end++;
+
+		anon_vma_lock_read(anon_vma);
+		anon_vma_interval_tree_foreach(avc, &anon_vma->rb_root,
+				items[start].pgoff, items[end - 1].pgoff) {
+			struct vm_area_struct *vma = avc->vma;
+			pgoff_t vma_pgoff_end = vma->vm_pgoff + vma_pages(vma);
+
+			cond_resched();
+
+			i = start;
+			while (i < end) {
+				unsigned long address, pmd_end;
+				int j;
+
+				if (items[i].pgoff < vma->vm_pgoff ||
+				    items[i].pgoff >= vma_pgoff_end) {
+					i++;
+					continue;
+				}
+
+				address = vma->vm_start +
+					((items[i].pgoff - vma->vm_pgoff) << PAGE_SHIFT);
+				pmd_end = pmd_addr_end(address, vma->vm_end);
+
+				/* items sharing the page table of items[i] */
+				for (j = i + 1; j < end; j++)
+					if (items[j].pgoff >= vma_pgoff_end ||
+					    items[j].pgoff - items[i].pgoff >=
+					    ((pmd_end - address) >> PAGE_SHIFT))
+						break;
+
+				remove_migration_ptes_pmd(vma, &items[i], j - i);
+				i = j;
+			}
+		}
+		anon_vma_unlock_read(anon_vma);
+	}
+out:
+	kfree(items);
+}
+
 /*
  * Something used the pte of a page under migration. We need to
  * get to the page and wait until migration is finished.
@@ -767,6 +943,7 @@ void migrate_page_states(struct page *newpage, struct page *page)
 		end_page_writeback(newpage);
 
 	copy_page_owner(page, newpage);
+	copy_page_age(page, newpage);
 
 	mem_cgroup_migrate(page, newpage);
 }
@@ -1523,8 +1700,11 @@ static int __unmap_page_concur(struct page *page, struct page *newpage,
 		lock_page(page);
 	}
 
-	/* We are working on page_mapping(page) == NULL */
-	VM_BUG_ON_PAGE(PageWriteback(page), page);
+	/* shmem and swap cache pages under writeback take the serial path */
+	if (PageWriteback(page)) {
+		rc = -ENODEV;
+		goto out_unlock;
+	}
 #if 0
 	if (PageWriteback(page)) {
 		/*
@@ -1604,21 +1784,15 @@ static int __unmap_page_concur(struct page *page, struct page *newpage,
 			goto out_unlock_both;
 		}
 	} else if (page_mapped(page)) {
-		/* Establish migration ptes */
+		/*
+		 * Migration ptes are established for the whole batch in
+		 * try_to_unmap_concurr()
+		 */
 		VM_BUG_ON_PAGE(PageAnon(page) && !PageKsm(page) && !*anon_vma,
 				page);
-		try_to_unmap(page,
-			TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
 		*page_was_mapped = 1;
 	}
 
-#ifdef CONFIG_PAGE_MIGRATION_PROFILE
-	timestamp = rdtsc();
-	current->move_pages_breakdown.unmap_page_cycles += timestamp -
-		current->move_pages_breakdown.last_timestamp;
-	current->move_pages_breakdown.last_timestamp = timestamp;
-#endif
-
 	return MIGRATEPAGE_SUCCESS;
 
 out_unlock_both:
@@ -1688,6 +1862,9 @@ static int unmap_pages_and_get_new_concur(new_page_t get_new_page,
 							force, mode);
 	if (rc == MIGRATEPAGE_SUCCESS)
 		return rc;
+	/* leave the old page on the list for migrate_pages() */
+	if (rc == -ENODEV)
+		goto put_new;
 
 out:
 	if (rc != -EAGAIN) {
@@ -1756,6 +1933,144 @@ static int unmap_pages_and_get_new_concur(new_page_t get_new_page,
 	return rc;
 }
 
+static void try_to_unmap_concurr(struct list_head *unmapped_list_ptr)
+{
+	struct page_migration_work_item *iterator;
+	struct page **page_list;
+	int num_pages = 0, idx = 0;
+
+	list_for_each_entry(iterator, unmapped_list_ptr, list)
+		if (iterator->page_was_mapped)
+			++num_pages;
+
+	if (!num_pages)
+		return;
+
+	page_list = kmalloc_array(num_pages, sizeof(struct page *), GFP_KERNEL);
+	if (!page_list) {
+		list_for_each_entry(iterator, unmapped_list_ptr, list)
+			if (iterator->page_was_mapped)
+				try_to_unmap(iterator->old_page,
+					TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
+		return;
+	}
+
+	list_for_each_entry(iterator, unmapped_list_ptr, list)
+		if (iterator->page_was_mapped)
+			page_list[idx++] = iterator->old_page;
+
+	try_to_unmap_batch(page_list, num_pages,
+		TTU_MIGRATION|TTU_IGNORE_MLOCK|TTU_IGNORE_ACCESS);
+
+	kfree(page_list);
+}
+
+/*
+ * Besides anonymous pages, shmem (tmpfs, memfd) and swap cache pages can be
+ * moved by the concurrent paths: their mapping only needs a radix tree slot
+ * replaced. Pages with fs-private data and shmem THPs are left to the serial
+ * paths.
+ */
+bool page_mapping_concur_movable(struct page *page)
+{
+	struct address_space *mapping = page_mapping(page);
+
+	if (!mapping)
+		return true;
+	if (PageTransHuge(page) || page_has_private(page))
+		return false;
+	return PageSwapCache(page) || shmem_mapping(mapping);
+}
+
+/*
+ * Replace the old page with the new page in its mapping. Same as
+ * migrate_page_move_mapping(), but the caller holds mapping->tree_lock with
+ * interrupts disabled so a batch of pages can share it.
+ */
+static int move_mapping_locked_concurr(struct address_space *mapping,
+				struct page *newpage, struct page *page)
+{
+	struct zone *oldzone = page_zone(page), *newzone = page_zone(newpage);
+	/* isolation and page cache references */
+	int expected_count = 2;
+	void **pslot;
+	int dirty;
+
+	pslot = radix_tree_lookup_slot(&mapping->page_tree, page_index(page));
+
+	if (page_count(page) != expected_count ||
+		radix_tree_deref_slot_protected(pslot, &mapping->tree_lock) != page)
+		return -EAGAIN;
+
+	if (!page_ref_freeze(page, expected_count))
+		return -EAGAIN;
+
+	newpage->index = page->index;
+	newpage->mapping = page->mapping;
+	get_page(newpage);	/* add cache reference */
+	if (PageSwapBacked(page)) {
+		__SetPageSwapBacked(newpage);
+		if (PageSwapCache(page)) {
+			SetPageSwapCache(newpage);
+			set_page_private(newpage, page_private(page));
+		}
+	}
+
+	/* Move dirty while page refs frozen and newpage not yet exposed */
+	dirty = PageDirty(page);
+	if (dirty) {
+		ClearPageDirty(page);
+		SetPageDirty(newpage);
+	}
+
+	radix_tree_replace_slot(&mapping->page_tree, pslot, newpage);
+
+	/* Drop cache reference from old page */
+	page_ref_unfreeze(page, expected_count - 1);
+
+	if (newzone != oldzone) {
+		__dec_node_state(oldzone->zone_pgdat, NR_FILE_PAGES);
+		__inc_node_state(newzone->zone_pgdat, NR_FILE_PAGES);
+		if (PageSwapBacked(page) && !PageSwapCache(page)) {
+			__dec_node_state(oldzone->zone_pgdat, NR_SHMEM);
+			__inc_node_state(newzone->zone_pgdat, NR_SHMEM);
+		}
+		if (dirty && mapping_cap_account_dirty(mapping)) {
+			__dec_node_state(oldzone->zone_pgdat, NR_FILE_DIRTY);
+			__dec_zone_state(oldzone, NR_ZONE_WRITE_PENDING);
+			__inc_node_state(newzone->zone_pgdat, NR_FILE_DIRTY);
+			__inc_zone_state(newzone, NR_ZONE_WRITE_PENDING);
+		}
+	}
+
+	return MIGRATEPAGE_SUCCESS;
+}
+
+/*
+ * Give up on an item whose mapping could not be moved: restore its ptes,
+ * unlock it and release the new page. The old page stays on the caller's
+ * list, so migrate_pages() retries it.
+ */
+static void move_mapping_concurr_undo(struct page_migration_work_item *iterator,
+					   struct list_head *wip_list_ptr,
+					   free_page_t put_new_page, unsigned long private)
+{
+	list_move(&iterator->list, wip_list_ptr);
+	if (iterator->page_was_mapped)
+		remove_migration_ptes(iterator->old_page,
+			iterator->old_page, false);
+	unlock_page(iterator->new_page);
+	if (iterator->anon_vma)
+		put_anon_vma(iterator->anon_vma);
+	unlock_page(iterator->old_page);
+
+	if (put_new_page)
+		put_new_page(iterator->new_page, private);
+	else
+		put_page(iterator->new_page);
+	iterator->new_page = NULL;
+}
+
 static int move_mapping_concurr(struct list_head *unmapped_list_ptr,
 					   struct list_head *wip_list_ptr,
 					   free_page_t put_new_page, unsigned long private,
@@ -1763,41 +2078,55 @@ static int move_mapping_concurr(struct list_head *unmapped_list_ptr,
 {
 	struct page_migration_work_item *iterator, *iterator2;
 	struct address_space *mapping;
+	LIST_HEAD(moved_list);
+	LIST_HEAD(failed_list);
+
+	while (!list_empty(unmapped_list_ptr)) {
+		iterator = list_first_entry(unmapped_list_ptr,
+				struct page_migration_work_item, list);
 
-	list_for_each_entry_safe(iterator, iterator2, unmapped_list_ptr, list) {
 		VM_BUG_ON_PAGE(!PageLocked(iterator->old_page), iterator->old_page);
 		VM_BUG_ON_PAGE(!PageLocked(iterator->new_page), iterator->new_page);
 
 		mapping = page_mapping(iterator->old_page);
 
-		VM_BUG_ON(mapping);
-
 		VM_BUG_ON(PageWriteback(iterator->old_page));
 
-		if (page_count(iterator->old_page) != 1) {
-			list_move(&iterator->list, wip_list_ptr);
-			if (iterator->page_was_mapped)
-				remove_migration_ptes(iterator->old_page,
-					iterator->old_page, false);
-			unlock_page(iterator->new_page);
-			if (iterator->anon_vma)
-				put_anon_vma(iterator->anon_vma);
-			unlock_page(iterator->old_page);
-
-			if (put_new_page)
-				put_new_page(iterator->new_page, private);
-			else
-				put_page(iterator->new_page);
-			iterator->new_page = NULL;
+		if (!mapping) {
+			if (page_count(iterator->old_page) != 1) {
+				list_move(&iterator->list, &failed_list);
+				continue;
+			}
+
+			iterator->new_page->index = iterator->old_page->index;
+			iterator->new_page->mapping = iterator->old_page->mapping;
+			if (PageSwapBacked(iterator->old_page))
+				SetPageSwapBacked(iterator->new_page);
+			list_move(&iterator->list, &moved_list);
 			continue;
 		}
 
-		iterator->new_page->index = iterator->old_page->index;
-		iterator->new_page->mapping = iterator->old_page->mapping;
-		if (PageSwapBacked(iterator->old_page))
-			SetPageSwapBacked(iterator->new_page);
+		/* replace every page of this mapping under one tree_lock */
+		spin_lock_irq(&mapping->tree_lock);
+		list_for_each_entry_safe(iterator, iterator2, unmapped_list_ptr, list) {
+			if (page_mapping(iterator->old_page) != mapping)
+				continue;
+
+			if (move_mapping_locked_concurr(mapping, iterator->new_page,
+						iterator->old_page))
+				list_move(&iterator->list, &failed_list);
+			else
+				list_move(&iterator->list, &moved_list);
+		}
+		spin_unlock_irq(&mapping->tree_lock);
 	}
 
+	list_for_each_entry_safe(iterator, iterator2, &failed_list, list)
+		move_mapping_concurr_undo(iterator, wip_list_ptr, put_new_page,
+				private);
+
+	list_splice(&moved_list, unmapped_list_ptr);
+
 	return 0;
 }
 
@@ -1884,27 +2213,62 @@ static int copy_to_new_pages_concur(struct list_head *unmapped_list_ptr,
 static int remove_migration_ptes_concurr(struct list_head *unmapped_list_ptr)
 {
 	struct page_migration_work_item *iterator, *iterator2;
+	struct page **old_page_list, **new_page_list = NULL;
+	int num_pages = 0, idx = 0;
+	LIST_HEAD(putback_list);
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
 	u64 timestamp;
 #endif
 
-	list_for_each_entry_safe(iterator, iterator2, unmapped_list_ptr, list) {
+	list_for_each_entry(iterator, unmapped_list_ptr, list)
 		if (iterator->page_was_mapped)
-			remove_migration_ptes(iterator->old_page, iterator->new_page, false);
+			++num_pages;
 
+	old_page_list = kmalloc_array(num_pages, sizeof(struct page *), GFP_KERNEL);
+	if (old_page_list)
+		new_page_list = kmalloc_array(num_pages, sizeof(struct page *),
+					GFP_KERNEL);
+
+	if (new_page_list) {
+		list_for_each_entry(iterator, unmapped_list_ptr, list) {
+			if (!iterator->page_was_mapped)
+				continue;
+			old_page_list[idx] = iterator->old_page;
+			new_page_list[idx] = iterator->new_page;
+			++idx;
+		}
+		remove_migration_ptes_batch(old_page_list, new_page_list, num_pages);
+	} else {
+		list_for_each_entry(iterator, unmapped_list_ptr, list)
+			if (iterator->page_was_mapped)
+				remove_migration_ptes(iterator->old_page,
+					iterator->new_page, false);
+	}
+
+	kfree(old_page_list);
+	kfree(new_page_list);
 
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
-		timestamp = rdtsc();
-		current->move_pages_breakdown.remove_migration_ptes_cycles += timestamp -
-			current->move_pages_breakdown.last_timestamp;
-		current->move_pages_breakdown.last_timestamp = timestamp;
+	timestamp = rdtsc();
+	current->move_pages_breakdown.remove_migration_ptes_cycles += timestamp -
+		current->move_pages_breakdown.last_timestamp;
+	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
 
+	list_for_each_entry_safe(iterator, iterator2, unmapped_list_ptr, list) {
 		unlock_page(iterator->new_page);
 
 		if (iterator->anon_vma)
 			put_anon_vma(iterator->anon_vma);
 
+		/*
+		 * The mapping now points at the new page. Anonymous and
+		 * movable ->mapping are cleared by free_pages_prepare, as in
+		 * move_to_new_page().
+		 */
+		if (!PageMappingFlags(iterator->old_page))
+			iterator->old_page->mapping = NULL;
+
 		unlock_page(iterator->old_page);
 
 		list_del(&iterator->old_page->lru);
@@ -1925,16 +2289,19 @@ static int remove_migration_ptes_concurr(struct list_head *unmapped_list_ptr)
 		if (unlikely(__PageMovable(iterator->new_page)))
 			put_page(iterator->new_page);
 		else
-			putback_lru_page(iterator->new_page);
+			list_add_tail(&iterator->new_page->lru, &putback_list);
 		iterator->new_page = NULL;
+	}
+
+	/* Put all new pages back under one lru_lock per node */
+	putback_lru_pages(&putback_list);
 
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
-		timestamp = rdtsc();
-		current->move_pages_breakdown.putback_new_page_cycles += timestamp -
-			current->move_pages_breakdown.last_timestamp;
-		current->move_pages_breakdown.last_timestamp = timestamp;
+	timestamp = rdtsc();
+	current->move_pages_breakdown.putback_new_page_cycles += timestamp -
+		current->move_pages_breakdown.last_timestamp;
+	current->move_pages_breakdown.last_timestamp = timestamp;
 #endif
-	}
 
 	return 0;
 }
@@ -1975,12 +2342,22 @@ int migrate_pages_concur(struct list_head *from, new_page_t get_new_page,
 	if (item_list_order > MAX_ORDER) {
 		item_list = alloc_pages_exact(total_num_pages *
 			sizeof(struct page_migration_work_item), GFP_ATOMIC);
-		memset(item_list, 0, total_num_pages *
-			sizeof(struct page_migration_work_item));
+		if (item_list)
+			memset(item_list, 0, total_num_pages *
+				sizeof(struct page_migration_work_item));
 	} else {
 		item_list = (struct page_migration_work_item *)__get_free_pages(GFP_ATOMIC,
 						item_list_order);
-		memset(item_list, 0, PAGE_SIZE<<item_list_order);
+		if (item_list)
+			memset(item_list, 0, PAGE_SIZE<<item_list_order);
+	}
+
+	/* large batches may not get their work items, migrate serially */
+	if (!item_list) {
+		if (!swapwrite)
+			current->flags &= ~PF_SWAPWRITE;
+		return migrate_pages(from, get_new_page, put_new_page,
+				private, mode, reason);
 	}
 
 	idx = 0;
@@ -2011,11 +2388,14 @@ int migrate_pages_concur(struct list_head *from, new_page_t get_new_page,
 				VM_BUG_ON_PAGE(1, iterator->old_page);
 			}
 
-			/* We do not migrate huge pages, file-backed, or swapcached pages */
+			/*
+			 * We do not migrate huge pages, or file-backed pages other
+			 * than shmem and swap cache pages
+			 */
 			if (PageHuge(iterator->old_page)) {
 				rc = -ENODEV;
 			}
-			else if ((page_mapping(iterator->old_page) != NULL)) {
+			else if (!page_mapping_concur_movable(iterator->old_page)) {
 				rc = -ENODEV;
 			}
 			else
@@ -2060,6 +2440,9 @@ int migrate_pages_concur(struct list_head *from, new_page_t get_new_page,
 		if (list_empty(&unmapped_list))
 			continue;
 
+		/* establish migration ptes for the whole batch */
+		try_to_unmap_concurr(&unmapped_list);
+
 #ifdef CONFIG_PAGE_MIGRATION_PROFILE
 		timestamp = rdtsc();
 		current->move_pages_breakdown.unmap_page_cycles += timestamp -
@@ -2862,6 +3245,180 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 	put_page(page);
 	return 0;
 }
+
+/*
+ * Hinting faults do not migrate misplaced base pages themselves. The page
+ * and its target node are recorded in a per-cpu batch, the same way
+ * pagevecs batch LRU additions, and a worker bound to that cpu migrates
+ * the whole batch at once through migrate_pages_concur(). This takes the
+ * copy off the faulting task and amortises the TLB shootdowns over the
+ * batch. The worker tells the faulting task how each migration went, see
+ * task_numa_queued_done().
+ */
+#define NUMA_PROMOTE_BATCH	32
+#define NUMA_PROMOTE_DELAY	1	/* jiffies before a partial batch drains */
+
+struct numa_promote_batch {
+	unsigned int nr;
+	struct page *pages[NUMA_PROMOTE_BATCH];
+	int nids[NUMA_PROMOTE_BATCH];
+	struct task_struct *tasks[NUMA_PROMOTE_BATCH];
+	struct delayed_work work;
+};
+
+static DEFINE_PER_CPU(struct numa_promote_batch, numa_promote_batches);
+
+static void numa_promote_migrate(struct page **pages, int *nids,
+				 struct task_struct **tasks,
+				 unsigned int nr, int node)
+{
+	pg_data_t *pgdat = NODE_DATA(node);
+	DECLARE_BITMAP(failed, NUMA_PROMOTE_BATCH);
+	unsigned int i, nr_pages = 0;
+	unsigned int promote_flags;
+	int nr_remaining;
+	struct page *page;
+	LIST_HEAD(migratepages);
+
+	bitmap_zero(failed, NUMA_PROMOTE_BATCH);
+	for (i = 0; i < nr; i++)
+		if (nids[i] == node)
+			nr_pages++;
+
+	/* The whole batch is charged against the target node at once. */
+	if (numamigrate_update_ratelimit(pgdat, nr_pages)) {
+		for (i = 0; i < nr; i++) {
+			if (nids[i] == node) {
+				put_page(pages[i]);
+				__set_bit(i, failed);
+			}
+		}
+		goto report;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (nids[i] != node)
+			continue;
+		if (numamigrate_isolate_page(pgdat, pages[i])) {
+			list_add_tail(&pages[i]->lru, &migratepages);
+		} else {
+			put_page(pages[i]);
+			__set_bit(i, failed);
+		}
+	}
+
+	if (list_empty(&migratepages))
+		goto report;
+
+	promote_flags = memalloc_promote_save();
+	nr_remaining = migrate_pages_concur(&migratepages,
+				alloc_misplaced_dst_page, NULL, node,
+				MIGRATE_ASYNC | MIGRATE_MT | MIGRATE_CONCUR,
+				MR_NUMA_MISPLACED);
+	memalloc_promote_restore(promote_flags);
+
+	/* Pages still on the list did not move */
+	list_for_each_entry(page, &migratepages, lru)
+		for (i = 0; i < nr; i++)
+			if (pages[i] == page && nids[i] == node)
+				__set_bit(i, failed);
+
+	/* -ENOMEM from the migrate_pages() fallback leaves pages behind too */
+	if (!list_empty(&migratepages))
+		putback_movable_pages(&migratepages);
+	if (nr_remaining >= 0 && nr_pages > nr_remaining)
+		count_vm_numa_events(NUMA_PAGE_MIGRATE, nr_pages - nr_remaining);
+
+report:
+	for (i = 0; i < nr; i++) {
+		if (nids[i] != node || !tasks[i])
+			continue;
+		task_numa_queued_done(tasks[i], !test_bit(i, failed));
+		put_task_struct(tasks[i]);
+	}
+}
+
+static void numa_promote_drain(struct work_struct *work)
+{
+	struct numa_promote_batch *batch = container_of(to_delayed_work(work),
+					struct numa_promote_batch, work);
+	struct page *pages[NUMA_PROMOTE_BATCH];
+	int nids[NUMA_PROMOTE_BATCH];
+	struct task_struct *tasks[NUMA_PROMOTE_BATCH];
+	unsigned int nr, i, j;
+
+	preempt_disable();
+	nr = batch->nr;
+	memcpy(pages, batch->pages, nr * sizeof(pages[0]));
+	memcpy(nids, batch->nids, nr * sizeof(nids[0]));
+	memcpy(tasks, batch->tasks, nr * sizeof(tasks[0]));
+	batch->nr = 0;
+	preempt_enable();
+
+	/* One migration per target node present in the batch. */
+	for (i = 0; i < nr; i++) {
+		int node = nids[i];
+
+		if (node == NUMA_NO_NODE)
+			continue;
+		numa_promote_migrate(pages, nids, tasks, nr, node);
+		for (j = i; j < nr; j++)
+			if (nids[j] == node)
+				nids[j] = NUMA_NO_NODE;
+	}
+}
+
+/*
+ * Queue a misplaced page for migration to @node. Like
+ * migrate_misplaced_page(), the caller's reference on the page is
+ * consumed. Returns -EINPROGRESS if the page was queued, in which case the
+ * worker reports the outcome to @p unless it is NULL. Otherwise returns 1
+ * if the page was migrated right away and 0 if it was not.
+ */
+int queue_misplaced_page(struct page *page, struct vm_area_struct *vma,
+			 int node, struct task_struct *p)
+{
+	struct numa_promote_batch *batch;
+
+	/* Same shared library exemption as migrate_misplaced_page(). */
+	if (page_mapcount(page) != 1 && page_is_file_cache(page) &&
+	    (vma->vm_flags & VM_EXEC)) {
+		put_page(page);
+		return 0;
+	}
+
+	batch = &get_cpu_var(numa_promote_batches);
+	if (batch->nr == NUMA_PROMOTE_BATCH) {
+		/* The worker has not caught up; fall back to the slow path. */
+		put_cpu_var(numa_promote_batches);
+		return migrate_misplaced_page(page, vma, node);
+	}
+	batch->pages[batch->nr] = page;
+	batch->nids[batch->nr] = node;
+	batch->tasks[batch->nr] = p;
+	if (p)
+		get_task_struct(p);
+	if (++batch->nr == NUMA_PROMOTE_BATCH)
+		mod_delayed_work_on(smp_processor_id(), system_wq,
+				    &batch->work, 0);
+	else if (batch->nr == 1)
+		queue_delayed_work_on(smp_processor_id(), system_wq,
+				      &batch->work, NUMA_PROMOTE_DELAY);
+	put_cpu_var(numa_promote_batches);
+
+	return -EINPROGRESS;
+}
+
+static int __init numa_promote_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		INIT_DELAYED_WORK(&per_cpu(numa_promote_batches, cpu).work,
+				  numa_promote_drain);
+	return 0;
+}
+subsys_initcall(numa_promote_init);
 #endif /* CONFIG_NUMA_BALANCING */
 
 #if defined(CONFIG_NUMA_BALANCING) && defined(CONFIG_TRANSPARENT_HUGEPAGE)
@@ -60,9 +60,13 @@ static unsigned long change_pte_range(struct vm_area_struct *vma, pmd_t *pmd,
 	 */
 	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
 
-	/* Get target node for single threaded private VMAs */
-	if (prot_numa && !(vma->vm_flags & VM_SHARED) &&
-	    atomic_read(&vma->vm_mm->mm_users) == 1)
+	/*
+	 * Get target node for single threaded private VMAs, or for any VMA
+	 * when only slow-tier resident pages are wanted.
+	 */
+	if (prot_numa == PROT_NUMA_TIER ||
+	    (prot_numa && !(vma->vm_flags & VM_SHARED) &&
+	     atomic_read(&vma->vm_mm->mm_users) == 1))
 		target_node = numa_node_id();
 
 	flush_tlb_batched_pending(vma->vm_mm);
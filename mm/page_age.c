@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Multi-generation page age for memory tiering.
+ *
+ * The two LRU lists only tell referenced pages from unreferenced ones.
+ * mm_manage ages pages with page_referenced() anyway, so each aging pass
+ * also records how many passes in a row a page went unreferenced. Pages
+ * to promote are then taken from the youngest generation and pages to
+ * demote from the oldest.
+ *
+ * The same page_ext entry remembers when a page last moved between nodes,
+ * so mm_manage can leave a page alone for a while after moving it instead
+ * of sending it back and forth across the active/inactive boundary.
+ *
+ * Like workingset shadow entries for evicted page cache, it also remembers
+ * when and from which node a page was demoted to a slower tier. A demoted
+ * page that is used again within tier_refault_window_ms is a tier refault:
+ * the demotion was a mistake, so the page is promoted back early and kswapd
+ * of the demoting node becomes pickier about what it demotes.
+ */
+
+#include <linux/jiffies.h>
+#include <linux/mm.h>
+#include <linux/moduleparam.h>
+#include <linux/page_ext.h>
+#include <linux/page_age.h>
+
+struct page_age {
+	unsigned int age;
+	int demote_nid;		/* node the page was last demoted from */
+	unsigned long migrate_jiffies;	/* last move between nodes, 0 if never */
+	unsigned long demote_jiffies;	/* last demotion, 0 if promoted since */
+};
+
+static unsigned int tier_refault_window_ms = 5000;
+module_param(tier_refault_window_ms, uint, 0644);
+
+/* jiffies of the last aging pass, 0 if no page was ever aged */
+unsigned long page_age_stamp;
+
+static bool page_age_disabled = true;
+DEFINE_STATIC_KEY_FALSE(page_age_inited);
+
+static int __init early_page_age_param(char *buf)
+{
+	if (!buf)
+		return -EINVAL;
+
+	if (strcmp(buf, "on") == 0)
+		page_age_disabled = false;
+
+	return 0;
+}
+early_param("page_age", early_page_age_param);
+
+static bool need_page_age(void)
+{
+	return !page_age_disabled;
+}
+
+static void init_page_age(void)
+{
+	if (page_age_disabled)
+		return;
+
+	static_branch_enable(&page_age_inited);
+}
+
+struct page_ext_operations page_age_ops = {
+	.size = sizeof(struct page_age),
+	.need = need_page_age,
+	.init = init_page_age,
+};
+
+static inline struct page_age *get_page_age(struct page *page)
+{
+	struct page_ext *page_ext = lookup_page_ext(compound_head(page));
+
+	if (unlikely(!page_ext))
+		return NULL;
+
+	return (void *)page_ext + page_age_ops.offset;
+}
+
+unsigned int __page_age(struct page *page)
+{
+	struct page_age *page_age = get_page_age(page);
+
+	return page_age ? READ_ONCE(page_age->age) : 0;
+}
+
+/* Called with the result of a page table access bit scan of @page. */
+void __page_age_update(struct page *page, bool referenced)
+{
+	struct page_age *page_age = get_page_age(page);
+	unsigned int age;
+
+	if (unlikely(!page_age))
+		return;
+
+	if (READ_ONCE(page_age_stamp) != jiffies)
+		WRITE_ONCE(page_age_stamp, jiffies);
+
+	age = READ_ONCE(page_age->age);
+	if (referenced)
+		age = 0;
+	else if (age < PAGE_AGE_MAX)
+		age++;
+	WRITE_ONCE(page_age->age, age);
+}
+
+void __reset_page_age(struct page *page)
+{
+	struct page_age *page_age = get_page_age(page);
+
+	if (page_age) {
+		WRITE_ONCE(page_age->age, 0);
+		WRITE_ONCE(page_age->migrate_jiffies, 0);
+		WRITE_ONCE(page_age->demote_jiffies, 0);
+	}
+}
+
+/* True if @page moved between nodes less than @window jiffies ago. */
+bool __page_migrated_within(struct page *page, unsigned long window)
+{
+	struct page_age *page_age = get_page_age(page);
+	unsigned long migrate_jiffies;
+
+	if (unlikely(!page_age))
+		return false;
+
+	migrate_jiffies = READ_ONCE(page_age->migrate_jiffies);
+	return migrate_jiffies && time_before(jiffies, migrate_jiffies + window);
+}
+
+static inline unsigned long page_migrate_stamp(void)
+{
+	/* 0 means never migrated */
+	return jiffies ?: 1;
+}
+
+/*
+ * The contents behind @page_age moved from node @from to node @to. Moving
+ * off a node with a promotion reserve onto one without is a demotion;
+ * moving onto a node with a reserve ends it.
+ */
+static void page_age_moved(struct page_age *page_age, int from, int to)
+{
+	unsigned long stamp = page_migrate_stamp();
+
+	WRITE_ONCE(page_age->migrate_jiffies, stamp);
+	if (READ_ONCE(NODE_DATA(to)->promote_reserve)) {
+		WRITE_ONCE(page_age->demote_jiffies, 0);
+	} else if (READ_ONCE(NODE_DATA(from)->promote_reserve)) {
+		WRITE_ONCE(page_age->demote_nid, from);
+		WRITE_ONCE(page_age->demote_jiffies, stamp);
+	}
+}
+
+void __copy_page_age(struct page *oldpage, struct page *newpage)
+{
+	struct page_age *old_age = get_page_age(oldpage);
+	struct page_age *new_age = get_page_age(newpage);
+	int old_nid = page_to_nid(oldpage), new_nid = page_to_nid(newpage);
+
+	if (unlikely(!old_age || !new_age))
+		return;
+
+	WRITE_ONCE(new_age->age, READ_ONCE(old_age->age));
+	WRITE_ONCE(new_age->migrate_jiffies, READ_ONCE(old_age->migrate_jiffies));
+	WRITE_ONCE(new_age->demote_nid, READ_ONCE(old_age->demote_nid));
+	WRITE_ONCE(new_age->demote_jiffies, READ_ONCE(old_age->demote_jiffies));
+	if (old_nid != new_nid)
+		page_age_moved(new_age, old_nid, new_nid);
+}
+
+/*
+ * Exchanged pages swap contents, so their ages swap with them. Both
+ * contents just changed node.
+ */
+void __exchange_page_age(struct page *page1, struct page *page2)
+{
+	struct page_age *age1 = get_page_age(page1);
+	struct page_age *age2 = get_page_age(page2);
+	int nid1 = page_to_nid(page1), nid2 = page_to_nid(page2);
+	struct page_age tmp;
+
+	if (unlikely(!age1 || !age2))
+		return;
+
+	tmp = *age1;
+	*age1 = *age2;
+	*age2 = tmp;
+
+	if (nid1 != nid2) {
+		page_age_moved(age1, nid2, nid1);
+		page_age_moved(age2, nid1, nid2);
+	}
+}
+
+/*
+ * Called when @page, found on a slow tier, is being used. Returns true if
+ * it was demoted less than tier_refault_window_ms ago, after charging the
+ * refault to the node that demoted it. Each demotion is charged at most
+ * once, however many scanners and faults see the page. The ping-pong
+ * hysteresis does not hold back undoing a mistaken demotion.
+ */
+bool __page_tier_refault(struct page *page)
+{
+	struct page_age *page_age = get_page_age(page);
+	unsigned long demote_jiffies;
+	int nid;
+
+	if (unlikely(!page_age))
+		return false;
+
+	demote_jiffies = READ_ONCE(page_age->demote_jiffies);
+	if (!demote_jiffies ||
+	    cmpxchg(&page_age->demote_jiffies, demote_jiffies, 0) != demote_jiffies)
+		return false;
+
+	if (!time_before(jiffies, demote_jiffies +
+			 msecs_to_jiffies(tier_refault_window_ms)))
+		return false;
+
+	WRITE_ONCE(page_age->migrate_jiffies, 0);
+	nid = READ_ONCE(page_age->demote_nid);
+	atomic_long_inc(&NODE_DATA(nid)->tier_refaults);
+	count_vm_event(PGTIER_REFAULT);
+	return true;
+}
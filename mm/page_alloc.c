@@ -62,6 +62,7 @@
 #include <linux/sched/rt.h>
 #include <linux/sched/mm.h>
 #include <linux/page_owner.h>
+#include <linux/page_age.h>
 #include <linux/kthread.h>
 #include <linux/memcontrol.h>
 #include <linux/ftrace.h>
@@ -1056,6 +1057,7 @@ static __always_inline bool free_pages_prepare(struct page *page,
 	page_cpupid_reset_last(page);
 	page->flags &= ~PAGE_FLAGS_CHECK_AT_PREP;
 	reset_page_owner(page, order);
+	reset_page_age(page);
 
 	if (!PageHighMem(page)) {
 		debug_check_no_locks_freed(page_address(page),
@@ -3131,6 +3133,8 @@ get_page_from_freelist(gfp_t gfp_mask, unsigned int order, int alloc_flags,
 		}
 
 		mark = zone->watermark[alloc_flags & ALLOC_WMARK_MASK];
+		if (!(alloc_flags & ALLOC_PROMOTE))
+			mark += zone->promote_reserve;
 		if (!zone_watermark_fast(zone, order, mark,
 				       ac_classzone_idx(ac), alloc_flags)) {
 			int ret;
@@ -3670,6 +3674,8 @@ gfp_to_alloc_flags(gfp_t gfp_mask)
 	if (gfpflags_to_migratetype(gfp_mask) == MIGRATE_MOVABLE)
 		alloc_flags |= ALLOC_CMA;
 #endif
+	if (!in_interrupt() && (current->flags & PF_MEMALLOC_PROMOTE))
+		alloc_flags |= ALLOC_PROMOTE;
 	return alloc_flags;
 }
 
@@ -4148,6 +4154,9 @@ static inline bool prepare_alloc_pages(gfp_t gfp_mask, unsigned int order,
 	if (IS_ENABLED(CONFIG_CMA) && ac->migratetype == MIGRATE_MOVABLE)
 		*alloc_flags |= ALLOC_CMA;
 
+	if (!in_interrupt() && (current->flags & PF_MEMALLOC_PROMOTE))
+		*alloc_flags |= ALLOC_PROMOTE;
+
 	return true;
 }
 
@@ -6895,6 +6904,17 @@ static void setup_per_zone_lowmem_reserve(void)
 	calculate_totalreserve_pages();
 }
 
+static unsigned long pgdat_managed_pages(pg_data_t *pgdat)
+{
+	unsigned long managed_pages = 0;
+	int i;
+
+	for (i = 0; i < MAX_NR_ZONES; i++)
+		managed_pages += pgdat->node_zones[i].managed_pages;
+
+	return managed_pages;
+}
+
 static void __setup_per_zone_wmarks(void)
 {
 	unsigned long pages_min = min_free_kbytes >> (PAGE_SHIFT - 10);
@@ -6949,6 +6969,15 @@ static void __setup_per_zone_wmarks(void)
 		zone->watermark[WMARK_LOW]  = min_wmark_pages(zone) + tmp;
 		zone->watermark[WMARK_HIGH] = min_wmark_pages(zone) + tmp * 2;
 
+		/* Spread the node's promotion reserve by zone size */
+		zone->promote_reserve = 0;
+		if (zone->zone_pgdat->promote_reserve && zone->managed_pages) {
+			tmp = (u64)zone->zone_pgdat->promote_reserve *
+				zone->managed_pages;
+			do_div(tmp, pgdat_managed_pages(zone->zone_pgdat));
+			zone->promote_reserve = tmp;
+		}
+
 		spin_unlock_irqrestore(&zone->lock, flags);
 	}
 
@@ -6972,6 +7001,22 @@ void setup_per_zone_wmarks(void)
 	spin_unlock(&lock);
 }
 
+/**
+ * set_promote_reserve - keep @nr_pages free on node @nid for promotion
+ *
+ * Allocations that are not made for promotion (see memalloc_promote_save())
+ * treat the reserve as part of every watermark of the node's zones, and
+ * kswapd demotes cold pages to keep it free.
+ */
+void set_promote_reserve(int nid, unsigned long nr_pages)
+{
+	pg_data_t *pgdat = NODE_DATA(nid);
+
+	WRITE_ONCE(pgdat->promote_reserve,
+		   min(nr_pages, pgdat_managed_pages(pgdat) / 2));
+	setup_per_zone_wmarks();
+}
+
 /*
  * Initialise min_free_kbytes.
  *
@@ -7455,6 +7500,34 @@ static unsigned long pfn_max_align_up(unsigned long pfn)
 				pageblock_nr_pages));
 }
 
+/*
+ * isolate_migratepages_range() stops at COMPACT_CLUSTER_MAX pages, which is
+ * too few for the concurrent migration path to amortize its batched unmap,
+ * TLB flush and multithreaded copy: gather several clusters per migration.
+ */
+#define CONTIG_MIGRATE_BATCH_PAGES	(16 * COMPACT_CLUSTER_MAX)
+
+static unsigned long isolate_contig_migrate_batch(struct compact_control *cc,
+					unsigned long pfn, unsigned long end)
+{
+	unsigned long nr_migratepages = 0;
+	LIST_HEAD(batch);
+
+	do {
+		cc->nr_migratepages = 0;
+		pfn = isolate_migratepages_range(cc, pfn, end);
+		nr_migratepages += cc->nr_migratepages;
+		list_splice_tail_init(&cc->migratepages, &batch);
+	} while (pfn && pfn < end &&
+		 nr_migratepages < CONTIG_MIGRATE_BATCH_PAGES &&
+		 !fatal_signal_pending(current));
+
+	list_splice(&batch, &cc->migratepages);
+	cc->nr_migratepages = nr_migratepages;
+
+	return pfn;
+}
+
 /* [start, end) must belong to a single zone. */
 static int __alloc_contig_migrate_range(struct compact_control *cc,
 					unsigned long start, unsigned long end)
@@ -7474,8 +7547,7 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 		}
 
 		if (list_empty(&cc->migratepages)) {
-			cc->nr_migratepages = 0;
-			pfn = isolate_migratepages_range(cc, pfn, end);
+			pfn = isolate_contig_migrate_batch(cc, pfn, end);
 			if (!pfn) {
 				ret = -EINTR;
 				break;
@@ -7490,8 +7562,9 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 							&cc->migratepages);
 		cc->nr_migratepages -= nr_reclaimed;
 
-		ret = migrate_pages(&cc->migratepages, alloc_migrate_target,
-				    NULL, 0, cc->mode, MR_CMA);
+		ret = migrate_pages_concur(&cc->migratepages,
+				alloc_migrate_target, NULL, 0,
+				cc->mode | MIGRATE_MT | MIGRATE_CONCUR, MR_CMA);
 	}
 	if (ret < 0) {
 		putback_movable_pages(&cc->migratepages);
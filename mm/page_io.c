@@ -24,8 +24,23 @@
 #include <linux/blkdev.h>
 #include <linux/uio.h>
 #include <linux/sched/task.h>
+#include <linux/workqueue.h>
 #include <asm/pgtable.h>
 
+/*
+ * Runs the plug flushes that cannot be done from inside schedule(). Reclaim
+ * waits for the writeback they start, so they need a rescuer.
+ */
+static struct workqueue_struct *swap_plug_wq;
+
+static int __init swap_plug_init(void)
+{
+	swap_plug_wq = alloc_workqueue("swap_plug",
+				       WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	return swap_plug_wq ? 0 : -ENOMEM;
+}
+subsys_initcall(swap_plug_init);
+
 static struct bio *get_swap_bio(gfp_t gfp_flags,
 				struct page *page, bio_end_io_t end_io)
 {
@@ -144,6 +159,76 @@ static void end_swap_bio_read(struct bio *bio)
 	put_task_struct(waiter);
 }
 
+static void end_swap_bio_read_contig(struct bio *bio)
+{
+	struct bio_vec *bvec;
+	int i;
+
+	if (bio->bi_status)
+		pr_alert("Read-error on swap-device (%u:%u:%llu)\n",
+			 MAJOR(bio_dev(bio)), MINOR(bio_dev(bio)),
+			 (unsigned long long)bio->bi_iter.bi_sector);
+
+	bio_for_each_segment_all(bvec, bio, i) {
+		struct page *page = bvec->bv_page;
+
+		if (bio->bi_status) {
+			SetPageError(page);
+			ClearPageUptodate(page);
+		} else {
+			SetPageUptodate(page);
+			swap_slot_free_notify(page);
+		}
+		unlock_page(page);
+	}
+	bio_put(bio);
+}
+
+/*
+ * Read @nr locked swap cache pages, physically contiguous from @page on and
+ * backed by consecutive swap slots, with as few bios as the block layer
+ * takes: one page per bvec, BIO_MAX_PAGES pages per bio. Where bios cannot
+ * do it (frontswap, swap over a filesystem, slots split across extents) the
+ * pages are read one by one instead.
+ */
+int swap_readpage_contig(struct page *page, int nr)
+{
+	struct swap_info_struct *sis = page_swap_info(page);
+	struct block_device *bdev;
+	struct bio *bio;
+	sector_t sector;
+	int i, done;
+
+	if (nr == 1 || frontswap_enabled() || (sis->flags & SWP_FILE))
+		goto fallback;
+
+	if (!swap_page_range_contig(page, nr))
+		goto fallback;
+
+	sector = map_swap_page(page, &bdev);
+	for (done = 0; done < nr; done += i) {
+		int nr_bio = min(nr - done, BIO_MAX_PAGES);
+
+		/* GFP_KERNEL bio allocations wait rather than fail */
+		bio = bio_alloc(GFP_KERNEL, nr_bio);
+		bio->bi_iter.bi_sector = (sector + done) << (PAGE_SHIFT - 9);
+		bio_set_dev(bio, bdev);
+		bio->bi_end_io = end_swap_bio_read_contig;
+		for (i = 0; i < nr_bio; i++)
+			bio_add_page(bio, page + done + i, PAGE_SIZE, 0);
+		VM_BUG_ON(bio->bi_iter.bi_size != PAGE_SIZE * nr_bio);
+		bio_set_op_attrs(bio, REQ_OP_READ, 0);
+		count_vm_events(PSWPIN, nr_bio);
+		submit_bio(bio);
+	}
+	return 0;
+
+fallback:
+	for (i = 0; i < nr; i++)
+		swap_readpage(page + i, false);
+	return 0;
+}
+
 int generic_swapfile_activate(struct swap_info_struct *sis,
 				struct file *swap_file,
 				sector_t *span)
@@ -238,6 +323,125 @@ int generic_swapfile_activate(struct swap_info_struct *sis,
 	goto out;
 }
 
+/*
+ * Reclaim writes to frontswap are collected on the caller's block plug and
+ * stored FRONTSWAP_BATCH_MAX at a time, so that the backend can compress
+ * them in parallel. Queued pages stay locked and under writeback until the
+ * batch is stored.
+ */
+struct swap_write_plug {
+	struct blk_plug_cb cb;
+	struct work_struct work;
+	int nr_pages;
+	struct page *pages[FRONTSWAP_BATCH_MAX];
+};
+
+static void swap_write_plug_flush(struct swap_write_plug *plug)
+{
+	struct writeback_control wbc = {
+		.sync_mode = WB_SYNC_NONE,
+	};
+	int rets[FRONTSWAP_BATCH_MAX];
+	int i;
+
+	if (!plug->nr_pages)
+		return;
+
+	frontswap_store_batch(plug->pages, plug->nr_pages, rets);
+
+	for (i = 0; i < plug->nr_pages; i++) {
+		struct page *page = plug->pages[i];
+
+		if (rets[i] == 0) {
+			unlock_page(page);
+			end_page_writeback(page);
+		} else {
+			/* keep PG_reclaim for the real write to the swap device */
+			bool reclaim = TestClearPageReclaim(page);
+
+			end_page_writeback(page);
+			if (reclaim)
+				SetPageReclaim(page);
+			__swap_writepage(page, &wbc, end_swap_bio_write);
+		}
+		put_page(page);
+	}
+	plug->nr_pages = 0;
+}
+
+static void swap_write_plug_work(struct work_struct *work)
+{
+	struct swap_write_plug *plug = container_of(work,
+			struct swap_write_plug, work);
+
+	swap_write_plug_flush(plug);
+	kfree(plug);
+}
+
+static void swap_write_unplug(struct blk_plug_cb *cb, bool from_schedule)
+{
+	struct swap_write_plug *plug = container_of(cb,
+			struct swap_write_plug, cb);
+
+	/* storing may sleep, which we cannot do from inside schedule() */
+	if (from_schedule) {
+		INIT_WORK(&plug->work, swap_write_plug_work);
+		queue_work(swap_plug_wq, &plug->work);
+		return;
+	}
+
+	swap_write_plug_flush(plug);
+	kfree(plug);
+}
+
+static bool swap_writepage_plugged(struct page *page,
+				   struct writeback_control *wbc)
+{
+	struct blk_plug_cb *cb;
+	struct swap_write_plug *plug;
+
+	if (!frontswap_enabled() || !wbc->for_reclaim || PageTransHuge(page) ||
+	    !swap_plug_wq)
+		return false;
+
+	cb = blk_check_plugged(swap_write_unplug, NULL,
+			       sizeof(struct swap_write_plug));
+	if (!cb)
+		return false;
+
+	plug = container_of(cb, struct swap_write_plug, cb);
+	get_page(page);
+	set_page_writeback(page);
+	plug->pages[plug->nr_pages++] = page;
+
+	if (plug->nr_pages == FRONTSWAP_BATCH_MAX)
+		swap_write_plug_flush(plug);
+
+	return true;
+}
+
+/*
+ * Store the frontswap batch queued on the current task's plug right away,
+ * so that reclaim can free the stored pages in the same pass instead of
+ * finding them under writeback.
+ */
+void swap_write_flush_plugged(void)
+{
+	struct blk_plug *plug = current->plug;
+	struct blk_plug_cb *cb;
+
+	if (!plug)
+		return;
+
+	list_for_each_entry(cb, &plug->cb_list, list) {
+		if (cb->callback == swap_write_unplug) {
+			swap_write_plug_flush(container_of(cb,
+					struct swap_write_plug, cb));
+			return;
+		}
+	}
+}
+
 /*
  * We may have stale swap cache pages in memory: notice
  * them here and get rid of the unnecessary final write.
@@ -250,6 +454,8 @@ int swap_writepage(struct page *page, struct writeback_control *wbc)
 		unlock_page(page);
 		goto out;
 	}
+	if (swap_writepage_plugged(page, wbc))
+		goto out;
 	if (frontswap_store(page) == 0) {
 		set_page_writeback(page);
 		unlock_page(page);
@@ -275,6 +481,126 @@ static inline void count_swpout_vm_event(struct page *page)
 	count_vm_events(PSWPOUT, hpage_nr_pages(page));
 }
 
+/*
+ * Reclaim pages out a whole batch under one block plug, and swap slots are
+ * handed out in per-cpu clusters, so consecutive writes mostly go to
+ * consecutive slots. Those are gathered into one bio on the plug rather
+ * than a bio per page for the block layer to merge back.
+ */
+struct swap_bio_plug {
+	struct blk_plug_cb cb;
+	struct work_struct work;
+	struct bio *bio;
+	struct block_device *bdev;
+	sector_t next_sector;	/* in pages, like map_swap_page() */
+};
+
+static void end_swap_bio_write_batch(struct bio *bio)
+{
+	struct bio_vec *bvec;
+	int i;
+
+	if (bio->bi_status)
+		pr_alert("Write-error on swap-device (%u:%u:%llu)\n",
+			 MAJOR(bio_dev(bio)), MINOR(bio_dev(bio)),
+			 (unsigned long long)bio->bi_iter.bi_sector);
+
+	bio_for_each_segment_all(bvec, bio, i) {
+		struct page *page = bvec->bv_page;
+
+		/* Same as end_swap_bio_write(), for every page */
+		if (bio->bi_status) {
+			SetPageError(page);
+			set_page_dirty(page);
+			ClearPageReclaim(page);
+		}
+		end_page_writeback(page);
+	}
+	bio_put(bio);
+}
+
+static void swap_bio_plug_submit(struct swap_bio_plug *plug)
+{
+	if (plug->bio) {
+		submit_bio(plug->bio);
+		plug->bio = NULL;
+	}
+}
+
+static void swap_bio_plug_work(struct work_struct *work)
+{
+	struct swap_bio_plug *plug = container_of(work,
+			struct swap_bio_plug, work);
+
+	swap_bio_plug_submit(plug);
+	kfree(plug);
+}
+
+static void swap_bio_unplug(struct blk_plug_cb *cb, bool from_schedule)
+{
+	struct swap_bio_plug *plug = container_of(cb,
+			struct swap_bio_plug, cb);
+
+	/* submit_bio() may sleep, which we cannot do from inside schedule() */
+	if (from_schedule) {
+		INIT_WORK(&plug->work, swap_bio_plug_work);
+		queue_work(swap_plug_wq, &plug->work);
+		return;
+	}
+
+	swap_bio_plug_submit(plug);
+	kfree(plug);
+}
+
+/*
+ * Add the locked swap cache @page to the bio on the caller's plug, starting
+ * a new bio when its slot does not follow the previous page's. The page is
+ * unlocked and under writeback on return. Returns false if it was not taken.
+ */
+static bool swap_write_bio_plugged(struct page *page,
+				   struct writeback_control *wbc)
+{
+	struct blk_plug_cb *cb;
+	struct swap_bio_plug *plug;
+	struct block_device *bdev;
+	sector_t sector;
+
+	if (!wbc->for_reclaim || PageTransHuge(page) || !swap_plug_wq)
+		return false;
+
+	cb = blk_check_plugged(swap_bio_unplug, NULL,
+			       sizeof(struct swap_bio_plug));
+	if (!cb)
+		return false;
+	plug = container_of(cb, struct swap_bio_plug, cb);
+
+	sector = map_swap_page(page, &bdev);
+	if (!plug->bio || plug->bdev != bdev || plug->next_sector != sector ||
+	    bio_add_page(plug->bio, page, PAGE_SIZE, 0) != PAGE_SIZE) {
+		swap_bio_plug_submit(plug);
+
+		plug->bio = bio_alloc(GFP_NOIO, BIO_MAX_PAGES);
+		if (!plug->bio)
+			return false;
+		plug->bio->bi_iter.bi_sector = sector << (PAGE_SHIFT - 9);
+		bio_set_dev(plug->bio, bdev);
+		plug->bio->bi_end_io = end_swap_bio_write_batch;
+		plug->bio->bi_opf = REQ_OP_WRITE | wbc_to_write_flags(wbc);
+		plug->bdev = bdev;
+		bio_add_page(plug->bio, page, PAGE_SIZE, 0);
+	}
+	plug->next_sector = sector + 1;
+
+	count_swpout_vm_event(page);
+	set_page_writeback(page);
+	unlock_page(page);
+
+	if (plug->bio->bi_vcnt == plug->bio->bi_max_vecs)
+		swap_bio_plug_submit(plug);
+
+	return true;
+}
+
 int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		bio_end_io_t end_write_func)
 {
@@ -331,6 +657,10 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	}
 
 	ret = 0;
+	if (end_write_func == end_swap_bio_write &&
+	    swap_write_bio_plugged(page, wbc))
+		return 0;
+
 	bio = get_swap_bio(GFP_NOIO, page, end_write_func);
 	if (bio == NULL) {
 		set_page_dirty(page);
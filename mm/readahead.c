@@ -180,7 +180,7 @@ int __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
-		page = __page_cache_alloc(gfp_mask);
+		page = __page_cache_alloc_use_once(gfp_mask);
 		if (!page)
 			break;
 		page->index = page_offset;
@@ -65,6 +65,7 @@
 #include <linux/page_idle.h>
 #include <linux/memremap.h>
 #include <linux/userfaultfd_k.h>
+#include <linux/sort.h>
 
 #include <asm/tlbflush.h>
 
@@ -880,6 +881,53 @@ int page_referenced(struct page *page,
 	return pra.referenced;
 }
 
+static bool page_tier_hint_one(struct page *page, struct vm_area_struct *vma,
+			       unsigned long address, void *arg)
+{
+	unsigned long *vm_flags = arg;
+
+	*vm_flags |= vma->vm_flags & VM_TIER_MASK;
+
+	return true;
+}
+
+/**
+ * page_tier_hint - collect the madvise tier hints of the VMAs mapping a page
+ * @page: the page to check
+ *
+ * Returns VM_TIER_FAST and/or VM_TIER_SLOW. A page whose lock is contended
+ * is reported as unhinted rather than waited for.
+ */
+unsigned long page_tier_hint(struct page *page)
+{
+	unsigned long vm_flags = 0;
+	int we_locked = 0;
+	struct rmap_walk_control rwc = {
+		.rmap_one = page_tier_hint_one,
+		.arg = (void *)&vm_flags,
+		.anon_lock = page_lock_anon_vma_read,
+	};
+
+	if (!READ_ONCE(vma_tier_hints_used))
+		return 0;
+
+	if (!page_mapped(page) || !page_rmapping(page))
+		return 0;
+
+	if (!PageAnon(page) || PageKsm(page)) {
+		we_locked = trylock_page(page);
+		if (!we_locked)
+			return 0;
+	}
+
+	rmap_walk(page, &rwc);
+
+	if (we_locked)
+		unlock_page(page);
+
+	return vm_flags;
+}
+
 static bool page_mkclean_one(struct page *page, struct vm_area_struct *vma,
 			    unsigned long address, void *arg)
 {
@@ -1373,7 +1421,8 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 		 */
 		adjust_range_if_pmd_sharing_possible(vma, &start, &end);
 	}
-	mmu_notifier_invalidate_range_start(vma->vm_mm, start, end);
+	if (!(flags & TTU_BATCH_NOTIFY))
+		mmu_notifier_invalidate_range_start(vma->vm_mm, start, end);
 
 	while (page_vma_mapped_walk(&pvmw)) {
 #ifdef CONFIG_ARCH_ENABLE_THP_MIGRATION
@@ -1596,11 +1645,13 @@ static bool try_to_unmap_one(struct page *page, struct vm_area_struct *vma,
 discard:
 		page_remove_rmap(subpage, PageHuge(page));
 		put_page(page);
-		mmu_notifier_invalidate_range(mm, address,
-					      address + PAGE_SIZE);
+		if (!(flags & TTU_BATCH_NOTIFY))
+			mmu_notifier_invalidate_range(mm, address,
+						      address + PAGE_SIZE);
 	}
 
-	mmu_notifier_invalidate_range_end(vma->vm_mm, start, end);
+	if (!(flags & TTU_BATCH_NOTIFY))
+		mmu_notifier_invalidate_range_end(vma->vm_mm, start, end);
 
 	return ret;
 }
@@ -1668,6 +1719,123 @@ bool try_to_unmap(struct page *page, enum ttu_flags flags)
 	return !page_mapcount(page) ? true : false;
 }
 
+static int anon_vma_page_cmp(const void *a, const void *b)
+{
+	struct page *lpage = *(struct page **)a;
+	struct page *rpage = *(struct page **)b;
+	struct anon_vma *l = page_anon_vma(lpage);
+	struct anon_vma *r = page_anon_vma(rpage);
+
+	if (l != r)
+		return l < r ? -1 : 1;
+	if (!l || page_to_pgoff(lpage) == page_to_pgoff(rpage))
+		return 0;
+	return page_to_pgoff(lpage) < page_to_pgoff(rpage) ? -1 : 1;
+}
+
+/* The part of @vma that maps [pgoff_start, pgoff_end] */
+static void vma_pgoff_range(struct vm_area_struct *vma, pgoff_t pgoff_start,
+		pgoff_t pgoff_end, unsigned long *start, unsigned long *end)
+{
+	*start = vma->vm_start;
+	if (pgoff_start > vma->vm_pgoff)
+		*start += (pgoff_start - vma->vm_pgoff) << PAGE_SHIFT;
+	*start = min(*start, vma->vm_end);
+	*end = vma->vm_start + ((pgoff_end + 1 - vma->vm_pgoff) << PAGE_SHIFT);
+	*end = min(*end, vma->vm_end);
+}
+
+/*
+ * Unmap a run of pages with contiguous offsets in @anon_vma. Each mapping
+ * of the run gets one mmu notifier invalidation instead of one per page,
+ * so secondary MMUs such as KVM zap and flush the range once. The anon_vma
+ * lock is held across, so the vmas and their ranges cannot change between
+ * the start and the end of the invalidation.
+ */
+static void try_to_unmap_anon_run(struct anon_vma *anon_vma,
+		struct page **pages, int nr, enum ttu_flags flags)
+{
+	pgoff_t pgoff_start = page_to_pgoff(pages[0]);
+	pgoff_t pgoff_end = page_to_pgoff(pages[nr - 1]) +
+			    hpage_nr_pages(pages[nr - 1]) - 1;
+	struct anon_vma_chain *avc;
+	unsigned long start, end;
+	int i;
+
+	if (nr == 1) {
+		try_to_unmap(pages[0], flags | TTU_RMAP_LOCKED);
+		return;
+	}
+
+	anon_vma_interval_tree_foreach(avc, &anon_vma->rb_root,
+			pgoff_start, pgoff_end) {
+		vma_pgoff_range(avc->vma, pgoff_start, pgoff_end, &start, &end);
+		mmu_notifier_invalidate_range_start(avc->vma->vm_mm, start, end);
+	}
+
+	for (i = 0; i < nr; i++)
+		try_to_unmap(pages[i],
+			     flags | TTU_RMAP_LOCKED | TTU_BATCH_NOTIFY);
+
+	anon_vma_interval_tree_foreach(avc, &anon_vma->rb_root,
+			pgoff_start, pgoff_end) {
+		vma_pgoff_range(avc->vma, pgoff_start, pgoff_end, &start, &end);
+		mmu_notifier_invalidate_range_end(avc->vma->vm_mm, start, end);
+	}
+}
+
+/**
+ * try_to_unmap_batch - try to remove all page table mappings to a batch of pages
+ * @pages: the pages to unmap, sorted by anon_vma and offset in place
+ * @nr: the number of pages in @pages
+ * @flags: action and flags, as for try_to_unmap()
+ *
+ * Pages from one process almost always share an anon_vma, so instead of
+ * taking the anon_vma lock once per page, take it once per group of pages
+ * sharing it and walk the rmap of each page with TTU_RMAP_LOCKED. Within a
+ * group, runs of contiguous base pages share one mmu notifier invalidation.
+ * THPs and hugetlb pages get their own walk under the group's lock, and KSM
+ * and file-backed pages are unmapped one by one.
+ *
+ * Caller must hold the page lock of every page and a reference on every
+ * anon_vma (see page_get_anon_vma()).
+ */
+void try_to_unmap_batch(struct page **pages, int nr, enum ttu_flags flags)
+{
+	int start, end, i, run_end;
+
+	sort(pages, nr, sizeof(struct page *), anon_vma_page_cmp, NULL);
+
+	for (start = 0; start < nr; start = end) {
+		struct anon_vma *anon_vma = page_anon_vma(pages[start]);
+
+		end = start + 1;
+		if (!anon_vma) {
+			try_to_unmap(pages[start], flags);
+			continue;
+		}
+
+		while (end < nr && page_anon_vma(pages[end]) == anon_vma)
+			end++;
+
+		anon_vma_lock_read(anon_vma);
+		for (i = start; i < end; i = run_end) {
+			run_end = i + 1;
+			if (PageCompound(pages[i])) {
+				try_to_unmap(pages[i], flags | TTU_RMAP_LOCKED);
+				continue;
+			}
+			while (run_end < end && !PageCompound(pages[run_end]) &&
+			       page_to_pgoff(pages[run_end]) ==
+			       page_to_pgoff(pages[run_end - 1]) + 1)
+				run_end++;
+			try_to_unmap_anon_run(anon_vma, pages + i,
+					      run_end - i, flags);
+		}
+		anon_vma_unlock_read(anon_vma);
+	}
+}
+
 static int page_not_mapped(struct page *page)
 {
 	return !page_mapped(page);
@@ -24,6 +24,8 @@
 
 #include <asm/pgtable.h>
 
+#include "internal.h"
+
 /*
  * swapper_space is a fiction, retained to simplify the path through
  * vmscan's shrink_page_list.
@@ -322,6 +324,57 @@ void free_pages_and_swap_cache(struct page **pages, int nr)
 	release_pages(pagep, nr, false);
 }
 
+#ifdef CONFIG_NUMA
+/*
+ * Speculative readahead pages go one tier below the faulting node when that
+ * node is a fast one, i.e. keeps a promotion reserve, and the memory policy
+ * at @addr allows it. Pages that turn out to be used get promoted back from
+ * there.
+ */
+static int swap_readahead_node(struct vm_area_struct *vma, unsigned long addr)
+{
+	int nid = numa_node_id();
+	int target;
+
+	if (vma && (vma->vm_flags & VM_TIER_FAST))
+		return NUMA_NO_NODE;
+	if (!READ_ONCE(NODE_DATA(nid)->promote_reserve))
+		return NUMA_NO_NODE;
+
+	target = demotion_target_node(NODE_DATA(nid));
+	if (target == NUMA_NO_NODE || !mpol_node_allowed(vma, addr, target))
+		return NUMA_NO_NODE;
+
+	return target;
+}
+#else
+static inline int swap_readahead_node(struct vm_area_struct *vma,
+				      unsigned long addr)
+{
+	return NUMA_NO_NODE;
+}
+#endif
+
+/* A readahead hit on the slow tier is a promotion candidate */
+static void swap_readahead_promote(struct page *page,
+				   struct vm_area_struct *vma)
+{
+#ifdef CONFIG_NUMA_BALANCING
+	int nid = numa_node_id();
+
+	if (!vma || (vma->vm_flags & VM_TIER_SLOW))
+		return;
+	if (page_to_nid(page) == nid ||
+	    READ_ONCE(NODE_DATA(page_to_nid(page))->promote_reserve) ||
+	    !READ_ONCE(NODE_DATA(nid)->promote_reserve))
+		return;
+
+	/* queue_misplaced_page() consumes the reference */
+	get_page(page);
+	queue_misplaced_page(page, vma, nid, NULL);
+#endif
+}
+
 /*
  * Lookup a swap entry in the swap cache. A found page will be returned
  * unlocked and with its refcount incremented - we rely on the kernel
@@ -356,14 +409,19 @@ struct page *lookup_swap_cache(swp_entry_t entry, struct vm_area_struct *vma,
 			count_vm_event(SWAP_RA_HIT);
 			if (!vma)
 				atomic_inc(&swapin_readahead_hits);
+			swap_readahead_promote(page, vma);
 		}
 	}
 	return page;
 }
 
-struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+/*
+ * Like __read_swap_cache_async(), but a new page is first tried on @nid,
+ * unless it is NUMA_NO_NODE, before falling back to the vma policy.
+ */
+static struct page *read_swap_cache_node(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr,
-			bool *new_page_allocated)
+			int nid, bool *new_page_allocated)
 {
 	struct page *found_page, *new_page = NULL;
 	struct address_space *swapper_space = swap_address_space(entry);
@@ -395,7 +453,12 @@ struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		 * Get a new page to read into from swap.
 		 */
 		if (!new_page) {
-			new_page = alloc_page_vma(gfp_mask, vma, addr);
+			if (nid != NUMA_NO_NODE)
+				new_page = __alloc_pages_node(nid, gfp_mask |
+						__GFP_THISNODE | __GFP_NORETRY |
+						__GFP_NOWARN, 0);
+			if (!new_page)
+				new_page = alloc_page_vma(gfp_mask, vma, addr);
 			if (!new_page)
 				break;		/* Out of memory */
 		}
@@ -453,6 +516,14 @@ struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *__read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr,
+			bool *new_page_allocated)
+{
+	return read_swap_cache_node(entry, gfp_mask, vma, addr, NUMA_NO_NODE,
+				    new_page_allocated);
+}
+
 /*
  * Locate a page of swap in physical memory, reserving swap cache space
  * and reading the disk if it is not already cached.
@@ -561,12 +632,14 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	unsigned long mask;
 	struct blk_plug plug;
 	bool do_poll = true, page_allocated;
+	int ra_nid;
 
 	mask = swapin_nr_pages(offset) - 1;
 	if (!mask)
 		goto skip;
 
 	do_poll = false;
+	ra_nid = swap_readahead_node(vma, addr);
 	/* Read a page_cluster sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
@@ -576,9 +649,10 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	blk_start_plug(&plug);
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = __read_swap_cache_async(
-			swp_entry(swp_type(entry), offset),
-			gfp_mask, vma, addr, &page_allocated);
+		page = read_swap_cache_node(
+			swp_entry(swp_type(entry), offset), gfp_mask, vma, addr,
+			offset != entry_offset ? ra_nid : NUMA_NO_NODE,
+			&page_allocated);
 		if (!page)
 			continue;
 		if (page_allocated) {
@@ -725,10 +799,13 @@ struct page *do_swap_page_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 	swp_entry_t entry;
 	unsigned int i;
 	bool page_allocated;
+	int ra_nid;
 
 	if (swap_ra->win == 1)
 		goto skip;
 
+	ra_nid = swap_readahead_node(vma, vmf->address);
+
 	blk_start_plug(&plug);
 	for (i = 0, pte = swap_ra->ptes; i < swap_ra->nr_pte;
 	     i++, pte++) {
@@ -740,8 +817,9 @@ struct page *do_swap_page_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 		entry = pte_to_swp_entry(pentry);
 		if (unlikely(non_swap_entry(entry)))
 			continue;
-		page = __read_swap_cache_async(entry, gfp_mask, vma,
-					       vmf->address, &page_allocated);
+		page = read_swap_cache_node(entry, gfp_mask, vma, vmf->address,
+				i != swap_ra->offset ? ra_nid : NUMA_NO_NODE,
+				&page_allocated);
 		if (!page)
 			continue;
 		if (page_allocated) {
@@ -761,6 +839,95 @@ struct page *do_swap_page_readahead(swp_entry_t fentry, gfp_t gfp_mask,
 				     swap_ra->win == 1);
 }
 
+#ifdef CONFIG_THP_SWAP
+/*
+ * A THP swapped out in one piece leaves a PMD's worth of ptes pointing at
+ * the consecutive slots of one swap cluster. Such a range is brought back
+ * in one go: one physically contiguous allocation on the node the vma
+ * policy picks for a huge page, one bio, and all pages in the swap cache
+ * for do_swap_page() to map. Returns the page for @entry with a reference
+ * held, or NULL to take the regular swapin path.
+ */
+struct page *swapin_huge_cluster(swp_entry_t entry, struct vm_fault *vmf)
+{
+	struct vm_area_struct *vma = vmf->vma;
+	unsigned long haddr = vmf->address & HPAGE_PMD_MASK;
+	unsigned long fault_idx = (vmf->address - haddr) >> PAGE_SHIFT;
+	unsigned long base = swp_offset(entry) - fault_idx;
+	struct page *page, *fault_page = NULL;
+	spinlock_t *ptl;
+	pte_t *pte;
+	int i, nr;
+
+	if (!transparent_hugepage_enabled(vma) ||
+	    haddr < vma->vm_start || haddr + HPAGE_PMD_SIZE > vma->vm_end ||
+	    swp_offset(entry) < fault_idx || !IS_ALIGNED(base, HPAGE_PMD_NR))
+		return NULL;
+
+	pte = pte_offset_map_lock(vma->vm_mm, vmf->pmd, haddr, &ptl);
+	for (i = 0; i < HPAGE_PMD_NR; i++) {
+		swp_entry_t ent;
+
+		if (pte_none(pte[i]) || pte_present(pte[i]))
+			break;
+		ent = pte_to_swp_entry(pte[i]);
+		if (swp_type(ent) != swp_type(entry) ||
+		    swp_offset(ent) != base + i)
+			break;
+	}
+	pte_unmap_unlock(pte, ptl);
+	if (i < HPAGE_PMD_NR)
+		return NULL;
+
+	page = alloc_pages_vma(GFP_TRANSHUGE_LIGHT & ~__GFP_COMP,
+			       HPAGE_PMD_ORDER, vma, haddr, numa_node_id(),
+			       true);
+	if (!page) {
+		count_vm_event(THP_SWPIN_FALLBACK);
+		return NULL;
+	}
+	split_page(page, HPAGE_PMD_ORDER);
+
+	for (nr = 0; nr < HPAGE_PMD_NR; nr++) {
+		swp_entry_t ent = swp_entry(swp_type(entry), base + nr);
+		struct page *subpage = page + nr;
+
+		if (radix_tree_maybe_preload(GFP_KERNEL))
+			break;
+		/* Stop at the first slot someone else is reading or freed */
+		if (swapcache_prepare(ent)) {
+			radix_tree_preload_end();
+			break;
+		}
+		__SetPageLocked(subpage);
+		__SetPageSwapBacked(subpage);
+		if (__add_to_swap_cache(subpage, ent)) {
+			radix_tree_preload_end();
+			__ClearPageLocked(subpage);
+			put_swap_page(subpage, ent);
+			break;
+		}
+		radix_tree_preload_end();
+		lru_cache_add_anon(subpage);
+	}
+
+	if (nr)
+		swap_readpage_contig(page, nr);
+	count_vm_event(nr == HPAGE_PMD_NR ? THP_SWPIN : THP_SWPIN_FALLBACK);
+
+	if (fault_idx < nr) {
+		fault_page = page + fault_idx;
+		get_page(fault_page);
+	}
+	/* The swap cache holds the pages read, the rest go back */
+	for (i = 0; i < HPAGE_PMD_NR; i++)
+		put_page(page + i);
+	lru_add_drain();
+
+	return fault_page;
+}
+#endif /* CONFIG_THP_SWAP */
+
 #ifdef CONFIG_SYSFS
 static ssize_t vma_ra_enabled_show(struct kobject *kobj,
 				     struct kobj_attribute *attr, char *buf)
@@ -2306,6 +2306,33 @@ sector_t map_swap_page(struct page *page, struct block_device **bdev)
 	return map_swap_entry(entry, bdev);
 }
 
+/*
+ * Returns true if the @nr swap slots from @page's swap entry on all lie in
+ * one swap extent, i.e. are backed by consecutive blocks of the device.
+ */
+bool swap_page_range_contig(struct page *page, unsigned long nr)
+{
+	struct swap_info_struct *sis;
+	struct swap_extent *start_se;
+	struct swap_extent *se;
+	swp_entry_t entry;
+	pgoff_t offset;
+
+	entry.val = page_private(page);
+	sis = swap_info[swp_type(entry)];
+	offset = swp_offset(entry);
+	start_se = sis->curr_swap_extent;
+	se = start_se;
+
+	for ( ; ; ) {
+		if (se->start_page <= offset &&
+				offset < (se->start_page + se->nr_pages))
+			return offset + nr <= se->start_page + se->nr_pages;
+		se = list_next_entry(se, list);
+		BUG_ON(se == start_se);		/* It *must* be present */
+	}
+}
+
 /*
  * Free all of a swapdev's extent information
  */
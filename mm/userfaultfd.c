@@ -574,3 +574,357 @@ ssize_t mfill_zeropage(struct mm_struct *dst_mm, unsigned long start,
 {
 	return __mcopy_atomic(dst_mm, start, 0, len, true);
 }
+
+static void double_pt_lock(spinlock_t *ptl1, spinlock_t *ptl2)
+{
+	if (ptl1 > ptl2)
+		swap(ptl1, ptl2);
+	spin_lock(ptl1);
+	if (ptl1 != ptl2)
+		spin_lock_nested(ptl2, SINGLE_DEPTH_NESTING);
+}
+
+static void double_pt_unlock(spinlock_t *ptl1, spinlock_t *ptl2)
+{
+	spin_unlock(ptl1);
+	if (ptl1 != ptl2)
+		spin_unlock(ptl2);
+}
+
+static void double_anon_vma_lock(struct anon_vma *root1,
+				 struct anon_vma *root2)
+{
+	if (root1 > root2)
+		swap(root1, root2);
+	down_write(&root1->rwsem);
+	if (root1 != root2)
+		down_write_nested(&root2->rwsem, SINGLE_DEPTH_NESTING);
+}
+
+static void double_anon_vma_unlock(struct anon_vma *root1,
+				   struct anon_vma *root2)
+{
+	up_write(&root1->rwsem);
+	if (root1 != root2)
+		up_write(&root2->rwsem);
+}
+
+/*
+ * Both pages (either may be NULL) are locked, lower one first; the second
+ * is only trylocked so two exchanges running in opposite directions cannot
+ * deadlock. Subpages of one THP share the lock of its head, taken once.
+ */
+static bool double_page_trylock(struct page *page1, struct page *page2)
+{
+	if (!page1 || !page2 || compound_head(page1) == compound_head(page2)) {
+		lock_page(page1 ? page1 : page2);
+		return true;
+	}
+	if (page1 > page2)
+		swap(page1, page2);
+	lock_page(page1);
+	if (trylock_page(page2))
+		return true;
+	unlock_page(page1);
+	return false;
+}
+
+static void double_page_unlock(struct page *page1, struct page *page2)
+{
+	if (page1)
+		unlock_page(page1);
+	if (page2)
+		unlock_page(page2);
+}
+
+/* The anon page behind @pte with a reference held, NULL for pte_none */
+static struct page *mexchange_pte_page(struct vm_area_struct *vma,
+				       unsigned long addr, pte_t pte)
+{
+	struct page *page;
+
+	if (pte_none(pte))
+		return NULL;
+	/* swapped out or under migration: let userland fault it in */
+	if (!pte_present(pte))
+		return ERR_PTR(-EAGAIN);
+
+	page = vm_normal_page(vma, addr, pte);
+	if (!page || !PageAnon(page) || PageKsm(page))
+		return ERR_PTR(-EBUSY);
+
+	get_page(page);
+	return page;
+}
+
+/*
+ * Only a page mapped by this one pte can change its address without any
+ * other mapping noticing, and its anon_vma must share the root of the vma
+ * it is mapped in, so the root locks we hold cover both its old and its
+ * new anon_vma. A page pinned by GUP, holding more references than its
+ * mapping, the swap cache and our own, may be under DMA and stays put.
+ */
+static bool mexchange_page_exclusive(struct page *page,
+				     struct anon_vma *root)
+{
+	if (!page)
+		return true;
+	if (page_anon_vma(page)->root != root || page_mapcount(page) != 1)
+		return false;
+	return page_count(page) == 2 + !!PageSwapCache(page);
+}
+
+static void mexchange_set_pte(struct mm_struct *mm, struct page *page,
+			      struct vm_area_struct *vma, unsigned long addr,
+			      pte_t *pte)
+{
+	pte_t _pte;
+
+	page_move_anon_rmap(page, vma);
+	page->index = linear_page_index(vma, addr);
+
+	_pte = maybe_mkwrite(pte_mkdirty(mk_pte(page, vma->vm_page_prot)), vma);
+	set_pte_at(mm, addr, pte, _pte);
+	update_mmu_cache(vma, addr, pte);
+}
+
+/*
+ * Swap the anon pages mapped at @dst_addr and @src_addr, or move the page
+ * when only one of them is mapped. Only the ptes and the rmap of the pages
+ * change, the page contents are not copied.
+ */
+static int mexchange_atomic_pte(struct mm_struct *mm,
+				struct vm_area_struct *dst_vma, pmd_t *dst_pmd,
+				unsigned long dst_addr,
+				struct vm_area_struct *src_vma, pmd_t *src_pmd,
+				unsigned long src_addr)
+{
+	struct anon_vma *dst_root = dst_vma->anon_vma->root;
+	struct anon_vma *src_root = src_vma->anon_vma->root;
+	struct page *dst_page, *src_page;
+	pte_t *dst_pte, *src_pte;
+	pte_t orig_dst_pte, orig_src_pte;
+	spinlock_t *dst_ptl, *src_ptl;
+	int err;
+
+again:
+	dst_pte = pte_offset_map(dst_pmd, dst_addr);
+	src_pte = pte_offset_map(src_pmd, src_addr);
+	dst_ptl = pte_lockptr(mm, dst_pmd);
+	src_ptl = pte_lockptr(mm, src_pmd);
+
+	double_pt_lock(dst_ptl, src_ptl);
+	orig_dst_pte = *dst_pte;
+	orig_src_pte = *src_pte;
+	dst_page = mexchange_pte_page(dst_vma, dst_addr, orig_dst_pte);
+	src_page = mexchange_pte_page(src_vma, src_addr, orig_src_pte);
+	double_pt_unlock(dst_ptl, src_ptl);
+	pte_unmap(src_pte);
+	pte_unmap(dst_pte);
+
+	err = 0;
+	if (IS_ERR(dst_page)) {
+		err = PTR_ERR(dst_page);
+		dst_page = NULL;
+	}
+	if (IS_ERR(src_page)) {
+		err = PTR_ERR(src_page);
+		src_page = NULL;
+	}
+	if (!err && !dst_page && !src_page)
+		err = -ENOENT;
+	if (err)
+		goto out_put;
+
+	err = -EAGAIN;
+	if (!double_page_trylock(dst_page, src_page))
+		goto out_put;
+
+	/* the pages of a pte-mapped THP cannot go separate ways */
+	if ((dst_page && PageTransCompound(dst_page)) ||
+	    (src_page && PageTransCompound(src_page))) {
+		/*
+		 * Both pages in one THP: its lock was taken once, and the
+		 * split wants no pin beyond ours on dst_page.
+		 */
+		if (dst_page && src_page &&
+		    compound_head(dst_page) == compound_head(src_page)) {
+			put_page(src_page);
+			src_page = NULL;
+		}
+
+		err = 0;
+		if (dst_page && PageTransCompound(dst_page))
+			err = split_huge_page(dst_page);
+		if (!err && src_page && PageTransCompound(src_page))
+			err = split_huge_page(src_page);
+		double_page_unlock(dst_page, src_page);
+		if (dst_page)
+			put_page(dst_page);
+		if (src_page)
+			put_page(src_page);
+		if (err)
+			return -EBUSY;
+		goto again;
+	}
+
+	double_anon_vma_lock(dst_root, src_root);
+	mmu_notifier_invalidate_range_start(mm, dst_addr, dst_addr + PAGE_SIZE);
+	mmu_notifier_invalidate_range_start(mm, src_addr, src_addr + PAGE_SIZE);
+
+	dst_pte = pte_offset_map(dst_pmd, dst_addr);
+	src_pte = pte_offset_map(src_pmd, src_addr);
+	double_pt_lock(dst_ptl, src_ptl);
+
+	err = -EAGAIN;
+	if (!pte_same(*dst_pte, orig_dst_pte) ||
+	    !pte_same(*src_pte, orig_src_pte))
+		goto out_unlock;
+
+	err = -EBUSY;
+	if (!mexchange_page_exclusive(dst_page, dst_root) ||
+	    !mexchange_page_exclusive(src_page, src_root))
+		goto out_unlock;
+
+	if (dst_page)
+		ptep_clear_flush(dst_vma, dst_addr, dst_pte);
+	if (src_page)
+		ptep_clear_flush(src_vma, src_addr, src_pte);
+
+	if (src_page)
+		mexchange_set_pte(mm, src_page, dst_vma, dst_addr, dst_pte);
+	if (dst_page)
+		mexchange_set_pte(mm, dst_page, src_vma, src_addr, src_pte);
+	err = 0;
+
+out_unlock:
+	double_pt_unlock(dst_ptl, src_ptl);
+	pte_unmap(src_pte);
+	pte_unmap(dst_pte);
+	mmu_notifier_invalidate_range_end(mm, src_addr, src_addr + PAGE_SIZE);
+	mmu_notifier_invalidate_range_end(mm, dst_addr, dst_addr + PAGE_SIZE);
+	double_anon_vma_unlock(dst_root, src_root);
+	double_page_unlock(dst_page, src_page);
+out_put:
+	if (dst_page)
+		put_page(dst_page);
+	if (src_page)
+		put_page(src_page);
+	return err;
+}
+
+static pmd_t *mexchange_get_pmd(struct mm_struct *mm,
+				struct vm_area_struct *vma, unsigned long addr)
+{
+	pmd_t *pmd;
+
+	pmd = mm_alloc_pmd(mm, addr);
+	if (unlikely(!pmd))
+		return ERR_PTR(-ENOMEM);
+
+	if (pmd_trans_huge(*pmd))
+		split_huge_pmd(vma, pmd, addr);
+	if (unlikely(pmd_none(*pmd)) && unlikely(__pte_alloc(mm, pmd, addr)))
+		return ERR_PTR(-ENOMEM);
+	/* If an huge pmd materialized from under us fail */
+	if (unlikely(pmd_trans_huge(*pmd)))
+		return ERR_PTR(-EAGAIN);
+
+	return pmd;
+}
+
+/**
+ * mexchange_atomic - swap the pages behind two userfaultfd registered ranges
+ * @mm: the mm both ranges belong to
+ * @dst_start: start of the first range
+ * @src_start: start of the second range
+ * @len: length of both ranges
+ *
+ * Page by page, the anon pages mapped at @dst_start and @src_start trade
+ * places; where only one side is mapped the page is moved and its old
+ * address left empty. Only page tables and rmap are updated, so relocating
+ * memory costs no copy. Pages must be exclusively mapped private anon
+ * pages. Returns the number of bytes exchanged, or an error if none were.
+ */
+ssize_t mexchange_atomic(struct mm_struct *mm, unsigned long dst_start,
+			 unsigned long src_start, unsigned long len)
+{
+	struct vm_area_struct *dst_vma, *src_vma;
+	unsigned long dst_addr, src_addr;
+	pmd_t *dst_pmd, *src_pmd;
+	long exchanged;
+	ssize_t err;
+
+	BUG_ON(dst_start & ~PAGE_MASK);
+	BUG_ON(src_start & ~PAGE_MASK);
+	BUG_ON(len & ~PAGE_MASK);
+
+	/* Does the address range wrap, or is the span zero-sized? */
+	BUG_ON(src_start + len <= src_start);
+	BUG_ON(dst_start + len <= dst_start);
+
+	exchanged = 0;
+	down_read(&mm->mmap_sem);
+
+	err = -ENOENT;
+	dst_vma = find_vma(mm, dst_start);
+	src_vma = find_vma(mm, src_start);
+	if (!dst_vma || !src_vma)
+		goto out_unlock;
+	/* Both ranges must belong to the same userfaultfd, as for UFFDIO_COPY */
+	if (!dst_vma->vm_userfaultfd_ctx.ctx ||
+	    dst_vma->vm_userfaultfd_ctx.ctx != src_vma->vm_userfaultfd_ctx.ctx)
+		goto out_unlock;
+	if (dst_start < dst_vma->vm_start ||
+	    dst_start + len > dst_vma->vm_end ||
+	    src_start < src_vma->vm_start ||
+	    src_start + len > src_vma->vm_end)
+		goto out_unlock;
+
+	err = -EINVAL;
+	if (!vma_is_anonymous(dst_vma) || !vma_is_anonymous(src_vma) ||
+	    (dst_vma->vm_flags | src_vma->vm_flags) & VM_SHARED)
+		goto out_unlock;
+	if (dst_start < src_start + len && src_start < dst_start + len)
+		goto out_unlock;
+
+	err = -ENOMEM;
+	if (unlikely(anon_vma_prepare(dst_vma)) ||
+	    unlikely(anon_vma_prepare(src_vma)))
+		goto out_unlock;
+
+	for (dst_addr = dst_start, src_addr = src_start;
+	     dst_addr < dst_start + len;
+	     dst_addr += PAGE_SIZE, src_addr += PAGE_SIZE) {
+		dst_pmd = mexchange_get_pmd(mm, dst_vma, dst_addr);
+		if (IS_ERR(dst_pmd)) {
+			err = PTR_ERR(dst_pmd);
+			break;
+		}
+		src_pmd = mexchange_get_pmd(mm, src_vma, src_addr);
+		if (IS_ERR(src_pmd)) {
+			err = PTR_ERR(src_pmd);
+			break;
+		}
+
+		err = mexchange_atomic_pte(mm, dst_vma, dst_pmd, dst_addr,
+					   src_vma, src_pmd, src_addr);
+		cond_resched();
+
+		if (!err) {
+			exchanged += PAGE_SIZE;
+
+			if (fatal_signal_pending(current))
+				err = -EINTR;
+		}
+		if (err)
+			break;
+	}
+
+out_unlock:
+	up_read(&mm->mmap_sem);
+	BUG_ON(exchanged < 0);
+	BUG_ON(err > 0);
+	BUG_ON(!exchanged && !err);
+	return exchanged ? exchanged : err;
+}
@@ -49,12 +49,15 @@
 #include <linux/prefetch.h>
 #include <linux/printk.h>
 #include <linux/dax.h>
+#include <linux/migrate.h>
+#include <linux/list_sort.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
 
 #include <linux/swapops.h>
 #include <linux/balloon_compaction.h>
+#include <linux/page_age.h>
 
 #include "internal.h"
 
@@ -851,6 +854,85 @@ void putback_lru_page(struct page *page)
 	put_page(page);		/* drop ref from isolate */
 }
 
+static int putback_lru_page_cmp(void *priv, struct list_head *a,
+				struct list_head *b)
+{
+	struct page *page_a = list_entry(a, struct page, lru);
+	struct page *page_b = list_entry(b, struct page, lru);
+
+	return page_to_nid(page_a) - page_to_nid(page_b);
+}
+
+/**
+ * putback_lru_pages - put a list of isolated pages back onto their LRUs
+ * @page_list: pages to add, linked through page->lru
+ *
+ * Equivalent to calling putback_lru_page() on every page, but pages are
+ * sorted by node and spliced straight onto their lruvec under one lru_lock
+ * acquisition per node instead of going through the per-cpu pagevecs.
+ * Active state is kept. @page_list is empty on return.
+ */
+void putback_lru_pages(struct list_head *page_list)
+{
+	struct pglist_data *pgdat = NULL;
+	LIST_HEAD(pages_to_free);
+
+	list_sort(NULL, page_list, putback_lru_page_cmp);
+
+	while (!list_empty(page_list)) {
+		struct page *page = lru_to_page(page_list);
+		struct lruvec *lruvec;
+		int lru;
+
+		VM_BUG_ON_PAGE(PageLRU(page), page);
+		list_del(&page->lru);
+		if (unlikely(!page_evictable(page))) {
+			if (pgdat) {
+				spin_unlock_irq(&pgdat->lru_lock);
+				pgdat = NULL;
+			}
+			putback_lru_page(page);
+			continue;
+		}
+
+		if (page_pgdat(page) != pgdat) {
+			if (pgdat)
+				spin_unlock_irq(&pgdat->lru_lock);
+			pgdat = page_pgdat(page);
+			spin_lock_irq(&pgdat->lru_lock);
+		}
+
+		lruvec = mem_cgroup_page_lruvec(page, pgdat);
+
+		/* PG_unevictable may be stale, e.g. copied over by migration */
+		if (TestClearPageUnevictable(page))
+			__count_vm_event(UNEVICTABLE_PGRESCUED);
+
+		SetPageLRU(page);
+		lru = page_lru(page);
+		add_page_to_lru_list(page, lruvec, lru);
+
+		if (put_page_testzero(page)) {
+			__ClearPageLRU(page);
+			__ClearPageActive(page);
+			del_page_from_lru_list(page, lruvec, lru);
+
+			if (unlikely(PageCompound(page))) {
+				spin_unlock_irq(&pgdat->lru_lock);
+				mem_cgroup_uncharge(page);
+				(*get_compound_page_dtor(page))(page);
+				spin_lock_irq(&pgdat->lru_lock);
+			} else
+				list_add(&page->lru, &pages_to_free);
+		}
+	}
+	if (pgdat)
+		spin_unlock_irq(&pgdat->lru_lock);
+
+	mem_cgroup_uncharge_list(&pages_to_free);
+	free_hot_cold_page_list(&pages_to_free, true);
+}
+
 enum page_references {
 	PAGEREF_RECLAIM,
 	PAGEREF_RECLAIM_CLEAN,
@@ -966,6 +1048,7 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+	LIST_HEAD(swap_pending);
 	int pgactivate = 0;
 	unsigned nr_unqueued_dirty = 0;
 	unsigned nr_dirty = 0;
@@ -1236,6 +1319,12 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 			case PAGE_ACTIVATE:
 				goto activate_locked;
 			case PAGE_SUCCESS:
+				if (PageWriteback(page) && PageSwapCache(page) &&
+				    !PageTransHuge(page)) {
+					/* may sit in a plugged frontswap batch */
+					list_add(&page->lru, &swap_pending);
+					continue;
+				}
 				if (PageWriteback(page))
 					goto keep;
 				if (PageDirty(page))
@@ -1350,6 +1439,35 @@ static unsigned long shrink_page_list(struct list_head *page_list,
 		VM_BUG_ON_PAGE(PageLRU(page) || PageUnevictable(page), page);
 	}
 
+	/*
+	 * swap_writepage() leaves pages queued for a frontswap batch locked
+	 * and under writeback until the plug is flushed. Store the batch now
+	 * and free whatever has been stored, as for a synchronous write.
+	 */
+	if (!list_empty(&swap_pending)) {
+		struct page *page, *next;
+
+		swap_write_flush_plugged();
+
+		list_for_each_entry_safe(page, next, &swap_pending, lru) {
+			list_del(&page->lru);
+			if (PageWriteback(page) || PageDirty(page) ||
+			    !trylock_page(page)) {
+				list_add(&page->lru, &ret_pages);
+				continue;
+			}
+			if (PageDirty(page) || PageWriteback(page) ||
+			    !__remove_mapping(page_mapping(page), page, true)) {
+				unlock_page(page);
+				list_add(&page->lru, &ret_pages);
+				continue;
+			}
+			__ClearPageLocked(page);
+			nr_reclaimed++;
+			list_add(&page->lru, &free_pages);
+		}
+	}
+
 	mem_cgroup_uncharge_list(&free_pages);
 	try_to_unmap_flush();
 	free_hot_cold_page_list(&free_pages, true);
@@ -1397,6 +1515,37 @@ unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 	return ret;
 }
 
+/*
+ * Reclaim isolated pages on behalf of mm_manage, which uses swap as the
+ * tier below the slowest memory node. Anonymous pages are written to swap
+ * (and so to zswap, when frontswap is enabled). Pages that could not be
+ * reclaimed are left on @page_list for the caller to put back.
+ */
+unsigned long reclaim_pages_from_list(struct pglist_data *pgdat,
+				      struct list_head *page_list)
+{
+	struct scan_control sc = {
+		.gfp_mask = GFP_KERNEL,
+		.priority = DEF_PRIORITY,
+		.may_writepage = 1,
+		.may_unmap = 1,
+		.may_swap = 1,
+	};
+	struct blk_plug plug;
+	struct page *page;
+	unsigned long nr_reclaimed;
+
+	list_for_each_entry(page, page_list, lru)
+		ClearPageActive(page);
+
+	/* lets swap_writepage() batch the stores into zswap or into bios */
+	blk_start_plug(&plug);
+	nr_reclaimed = shrink_page_list(page_list, pgdat, &sc, 0, NULL, false);
+	blk_finish_plug(&plug);
+
+	return nr_reclaimed;
+}
+
 /*
  * Attempt to remove the specified page from its LRU.  Only take this page
  * if it is of the appropriate PageActive status.  Pages which are being
@@ -3168,6 +3317,205 @@ static void age_active_anon(struct pglist_data *pgdat,
 	} while (memcg);
 }
 
+/*
+ * Cold pages of a node that keeps a promotion reserve are demoted to the
+ * nearest node that keeps none, i.e. the next tier down.
+ */
+int demotion_target_node(pg_data_t *pgdat)
+{
+	int nid, target = NUMA_NO_NODE;
+	int best = INT_MAX;
+
+	for_each_node_state(nid, N_MEMORY) {
+		if (nid == pgdat->node_id ||
+		    READ_ONCE(NODE_DATA(nid)->promote_reserve))
+			continue;
+		if (node_distance(pgdat->node_id, nid) < best) {
+			best = node_distance(pgdat->node_id, nid);
+			target = nid;
+		}
+	}
+
+	return target;
+}
+
+static struct page *alloc_demote_page(struct page *page, unsigned long node)
+{
+	struct page *newpage;
+
+	if (PageTransHuge(page)) {
+		newpage = alloc_pages_node(node,
+				GFP_TRANSHUGE_LIGHT | __GFP_THISNODE,
+				HPAGE_PMD_ORDER);
+		if (newpage)
+			prep_transhuge_page(newpage);
+		return newpage;
+	}
+
+	/* Never dip into the target's reserves or reclaim on its behalf */
+	return __alloc_pages_node(node, (GFP_HIGHUSER_MOVABLE |
+				  __GFP_THISNODE | __GFP_NOMEMALLOC |
+				  __GFP_NORETRY | __GFP_NOWARN) &
+				 ~__GFP_RECLAIM, 0);
+}
+
+#ifdef CONFIG_PAGE_AGE
+/* Pages kswapd must consider for demotion before adjusting demote_min_age */
+#define DEMOTE_FEEDBACK_BATCH	(SWAP_CLUSTER_MAX * 32)
+
+static inline unsigned int demote_min_age(pg_data_t *pgdat)
+{
+	return READ_ONCE(pgdat->demote_min_age);
+}
+
+static inline void count_demote_scanned(pg_data_t *pgdat, unsigned long nr)
+{
+	pgdat->tier_demote_scanned += nr;
+}
+
+/*
+ * Tier refault feedback. If more than 1/8 of the pages kswapd of @pgdat
+ * considered came back as tier refaults, it is demoting pages that are
+ * still in use: only demote pages of the next older generation from now
+ * on. Below 1/32, go back one generation. Only kswapd of @pgdat writes
+ * these fields.
+ *
+ * Ages only advance while SHRINK_LISTS scans page tables, kswapd does not
+ * age pages itself. If no page was aged since the last adjustment the ages
+ * are stale, so stop gating on them until aging resumes.
+ */
+static void update_demote_min_age(pg_data_t *pgdat)
+{
+	unsigned long scanned = pgdat->tier_demote_scanned;
+	unsigned long refaults, stamp;
+	unsigned int min_age = pgdat->demote_min_age;
+
+	if (!page_age_enabled() || scanned < DEMOTE_FEEDBACK_BATCH)
+		return;
+
+	refaults = atomic_long_xchg(&pgdat->tier_refaults, 0);
+	stamp = READ_ONCE(page_age_stamp);
+	if (stamp == pgdat->demote_age_stamp)
+		min_age = 0;
+	else if (refaults * 8 > scanned && min_age < PAGE_AGE_MAX)
+		min_age++;
+	else if (refaults * 32 < scanned && min_age)
+		min_age--;
+
+	WRITE_ONCE(pgdat->demote_min_age, min_age);
+	pgdat->demote_age_stamp = stamp;
+	pgdat->tier_demote_scanned = 0;
+}
+#else
+static inline unsigned int demote_min_age(pg_data_t *pgdat)
+{
+	return 0;
+}
+
+static inline void count_demote_scanned(pg_data_t *pgdat, unsigned long nr)
+{
+}
+
+static inline void update_demote_min_age(pg_data_t *pgdat)
+{
+}
+#endif
+
+static unsigned long demote_lruvec_list(pg_data_t *pgdat, int target,
+		struct lruvec *lruvec, struct scan_control *sc,
+		enum lru_list lru)
+{
+	int file = is_file_lru(lru);
+	unsigned long nr_taken, nr_scanned, nr_failed = 0;
+	struct page *page, *next;
+	LIST_HEAD(page_list);
+	LIST_HEAD(pinned_list);
+
+	lru_add_drain();
+
+	spin_lock_irq(&pgdat->lru_lock);
+	nr_taken = isolate_lru_pages(SWAP_CLUSTER_MAX, lruvec, &page_list,
+				     &nr_scanned, sc, ISOLATE_ASYNC_MIGRATE, lru);
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + file, nr_taken);
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	if (!nr_taken)
+		return 0;
+
+	/*
+	 * MADV_TIER_FAST pages stay, and go back active to be scanned less.
+	 * Pages younger than demote_min_age stay too, on the inactive list.
+	 */
+	list_for_each_entry_safe(page, next, &page_list, lru) {
+		if (page_tier_hint(page) & VM_TIER_FAST) {
+			SetPageActive(page);
+			list_move(&page->lru, &pinned_list);
+		} else if (page_age(page) < demote_min_age(pgdat))
+			list_move(&page->lru, &pinned_list);
+	}
+	count_demote_scanned(pgdat, nr_taken);
+
+	migrate_pages_concur(&page_list, alloc_demote_page, NULL, target,
+			     MIGRATE_ASYNC | MIGRATE_CONCUR, MR_DEMOTION);
+	list_splice(&pinned_list, &page_list);
+
+	list_for_each_entry(page, &page_list, lru)
+		nr_failed += hpage_nr_pages(page);
+	putback_movable_pages(&page_list);
+
+	return nr_taken - nr_failed;
+}
+
+/*
+ * Make room for the promotion reserve of @pgdat by moving inactive pages to
+ * the next tier. Returns the number of base pages demoted.
+ */
+static unsigned long kswapd_demote_node(pg_data_t *pgdat,
+					struct scan_control *sc)
+{
+	unsigned long nr_to_demote = 0, nr_demoted = 0;
+	struct mem_cgroup *memcg;
+	struct zone *zone;
+	int target, z;
+
+	target = demotion_target_node(pgdat);
+	if (target == NUMA_NO_NODE)
+		return 0;
+
+	update_demote_min_age(pgdat);
+
+	for (z = 0; z <= sc->reclaim_idx; z++) {
+		unsigned long mark, free;
+
+		zone = pgdat->node_zones + z;
+		if (!managed_zone(zone))
+			continue;
+
+		mark = high_wmark_pages(zone) + zone->promote_reserve;
+		free = zone_page_state(zone, NR_FREE_PAGES);
+		if (free < mark)
+			nr_to_demote += mark - free;
+	}
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		struct lruvec *lruvec = mem_cgroup_lruvec(pgdat, memcg);
+
+		nr_demoted += demote_lruvec_list(pgdat, target, lruvec, sc,
+						 LRU_INACTIVE_FILE);
+		nr_demoted += demote_lruvec_list(pgdat, target, lruvec, sc,
+						 LRU_INACTIVE_ANON);
+
+		if (nr_demoted >= nr_to_demote) {
+			mem_cgroup_iter_break(NULL, memcg);
+			break;
+		}
+		memcg = mem_cgroup_iter(NULL, memcg, NULL);
+	} while (memcg);
+
+	return nr_demoted;
+}
+
 /*
  * Returns true if there is an eligible zone balanced for the request order
  * and classzone_idx
@@ -3184,7 +3532,7 @@ static bool pgdat_balanced(pg_data_t *pgdat, int order, int classzone_idx)
 		if (!managed_zone(zone))
 			continue;
 
-		mark = high_wmark_pages(zone);
+		mark = high_wmark_pages(zone) + zone->promote_reserve;
 		if (zone_watermark_ok_safe(zone, order, mark, classzone_idx))
 			return true;
 	}
@@ -3359,6 +3707,17 @@ static int balance_pgdat(pg_data_t *pgdat, int order, int classzone_idx)
 		 */
 		age_active_anon(pgdat, &sc);
 
+		/*
+		 * A node keeping a promotion reserve frees it by demoting
+		 * cold pages to the next tier, and only reclaims what
+		 * demotion could not free.
+		 */
+		if (pgdat->promote_reserve) {
+			sc.nr_reclaimed += kswapd_demote_node(pgdat, &sc);
+			if (pgdat_balanced(pgdat, sc.order, classzone_idx))
+				goto out;
+		}
+
 		/*
 		 * If we're getting trouble reclaiming, start doing writepage
 		 * even in laptop mode.
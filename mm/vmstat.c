@@ -1150,6 +1150,9 @@ const char * const vmstat_text[] = {
 	"pgmigrate_success",
 	"pgmigrate_fail",
 #endif
+#ifdef CONFIG_PAGE_AGE
+	"pgtier_refault",
+#endif
 #ifdef CONFIG_COMPACTION
 	"compact_migrate_scanned",
 	"compact_free_scanned",
@@ -1192,6 +1195,8 @@ const char * const vmstat_text[] = {
 	"thp_zero_page_alloc_failed",
 	"thp_swpout",
 	"thp_swpout_fallback",
+	"thp_swpin",
+	"thp_swpin_fallback",
 #endif
 #ifdef CONFIG_MEMORY_BALLOON
 	"balloon_inflate",
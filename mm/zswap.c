@@ -41,6 +41,7 @@
 #include <linux/swapops.h>
 #include <linux/writeback.h>
 #include <linux/pagemap.h>
+#include <linux/workqueue.h>
 
 /*********************************
 * statistics
@@ -116,6 +117,12 @@ module_param_cb(zpool, &zswap_zpool_param_ops, &zswap_zpool_type, 0644);
 static unsigned int zswap_max_pool_percent = 20;
 module_param_named(max_pool_percent, zswap_max_pool_percent, uint, 0644);
 
+/* Batched stores use as many compression workers as multi-threaded copy */
+extern unsigned int limit_mt_num;
+
+/* Reclaim waits on the compression workers, so they need a rescuer */
+static struct workqueue_struct *zswap_compress_wq;
+
 /*********************************
 * data structures
 **********************************/
@@ -956,12 +963,14 @@ static int zswap_shrink(void)
 /*********************************
 * frontswap hooks
 **********************************/
-/* attempts to compress and store an single page */
-static int zswap_frontswap_store(unsigned type, pgoff_t offset,
-				struct page *page)
+/*
+ * Compress @page into @entry->pool and fill in @entry. Uses the per-cpu
+ * compressor of whichever CPU it runs on, so batched stores can call it
+ * from worker threads.
+ */
+static int zswap_compress_entry(struct zswap_entry *entry, unsigned type,
+				pgoff_t offset, struct page *page)
 {
-	struct zswap_tree *tree = zswap_trees[type];
-	struct zswap_entry *entry, *dupentry;
 	struct crypto_comp *tfm;
 	int ret;
 	unsigned int dlen = PAGE_SIZE, len;
@@ -970,51 +979,6 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	u8 *src, *dst;
 	struct zswap_header *zhdr;
 
-	/* THP isn't supported */
-	if (PageTransHuge(page)) {
-		ret = -EINVAL;
-		goto reject;
-	}
-
-	if (!zswap_enabled || !tree) {
-		ret = -ENODEV;
-		goto reject;
-	}
-
-	/* reclaim space if needed */
-	if (zswap_is_full()) {
-		zswap_pool_limit_hit++;
-		if (zswap_shrink()) {
-			zswap_reject_reclaim_fail++;
-			ret = -ENOMEM;
-			goto reject;
-		}
-
-		/* A second zswap_is_full() check after
-		 * zswap_shrink() to make sure it's now
-		 * under the max_pool_percent
-		 */
-		if (zswap_is_full()) {
-			ret = -ENOMEM;
-			goto reject;
-		}
-	}
-
-	/* allocate entry */
-	entry = zswap_entry_cache_alloc(GFP_KERNEL);
-	if (!entry) {
-		zswap_reject_kmemcache_fail++;
-		ret = -ENOMEM;
-		goto reject;
-	}
-
-	/* if entry is successfully added, it keeps the reference */
-	entry->pool = zswap_pool_current_get();
-	if (!entry->pool) {
-		ret = -EINVAL;
-		goto freepage;
-	}
-
 	/* compress */
 	dst = get_cpu_var(zswap_dstmem);
 	tfm = *get_cpu_ptr(entry->pool->tfm);
@@ -1052,8 +1016,20 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	entry->handle = handle;
 	entry->length = dlen;
 
-	/* map */
-	spin_lock(&tree->lock);
+	return 0;
+
+put_dstmem:
+	put_cpu_var(zswap_dstmem);
+	return ret;
+}
+
+/* caller must hold the tree lock */
+static void zswap_rb_insert_replace(struct zswap_tree *tree,
+				struct zswap_entry *entry)
+{
+	struct zswap_entry *dupentry;
+	int ret;
+
 	do {
 		ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
 		if (ret == -EEXIST) {
@@ -1063,6 +1039,72 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 			zswap_entry_put(tree, dupentry);
 		}
 	} while (ret == -EEXIST);
+}
+
+/* reclaim space if needed */
+static int zswap_make_room(void)
+{
+	if (zswap_is_full()) {
+		zswap_pool_limit_hit++;
+		if (zswap_shrink()) {
+			zswap_reject_reclaim_fail++;
+			return -ENOMEM;
+		}
+
+		/* A second zswap_is_full() check after
+		 * zswap_shrink() to make sure it's now
+		 * under the max_pool_percent
+		 */
+		if (zswap_is_full())
+			return -ENOMEM;
+	}
+	return 0;
+}
+
+static int zswap_frontswap_store(unsigned type, pgoff_t offset,
+				struct page *page)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entry;
+	int ret;
+
+	/* THP isn't supported */
+	if (PageTransHuge(page)) {
+		ret = -EINVAL;
+		goto reject;
+	}
+
+	if (!zswap_enabled || !tree) {
+		ret = -ENODEV;
+		goto reject;
+	}
+
+	ret = zswap_make_room();
+	if (ret)
+		goto reject;
+
+	/* allocate entry */
+	entry = zswap_entry_cache_alloc(GFP_KERNEL);
+	if (!entry) {
+		zswap_reject_kmemcache_fail++;
+		ret = -ENOMEM;
+		goto reject;
+	}
+
+	/* if entry is successfully added, it keeps the reference */
+	entry->pool = zswap_pool_current_get();
+	if (!entry->pool) {
+		ret = -EINVAL;
+		goto freepage;
+	}
+
+	ret = zswap_compress_entry(entry, type, offset, page);
+	if (ret)
+		goto put_pool;
+
+	/* map */
+	spin_lock(&tree->lock);
+	zswap_rb_insert_replace(tree, entry);
 	spin_unlock(&tree->lock);
 
 	/* update stats */
@@ -1071,8 +1113,7 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 
 	return 0;
 
-put_dstmem:
-	put_cpu_var(zswap_dstmem);
+put_pool:
 	zswap_pool_put(entry->pool);
 freepage:
 	zswap_entry_cache_free(entry);
@@ -1080,6 +1121,171 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 	return ret;
 }
 
+struct zswap_compress_work {
+	struct work_struct work;
+	unsigned type;
+	int first;
+	int stride;
+	int nr;
+	pgoff_t *offsets;
+	struct page **pages;
+	struct zswap_entry **entries;
+	int *rets;
+};
+
+static void zswap_compress_work_thread(struct work_struct *work)
+{
+	struct zswap_compress_work *my_work = (struct zswap_compress_work *)work;
+	int i;
+
+	for (i = my_work->first; i < my_work->nr; i += my_work->stride)
+		if (my_work->entries[i])
+			my_work->rets[i] = zswap_compress_entry(my_work->entries[i],
+					my_work->type, my_work->offsets[i],
+					my_work->pages[i]);
+}
+
+/*
+ * Compress a batch of pages with up to limit_mt_num workers running on the
+ * CPUs of the current node. Falls back to compressing on this CPU if the
+ * workqueue or the work items cannot be allocated.
+ */
+static void zswap_compress_entries(unsigned type, pgoff_t *offsets,
+				struct page **pages, struct zswap_entry **entries,
+				int nr, int *rets)
+{
+	const struct cpumask *per_node_cpumask = cpumask_of_node(numa_node_id());
+	unsigned int total_mt_num = limit_mt_num;
+	struct zswap_compress_work *work_items = NULL;
+	int i, cpu;
+
+	total_mt_num = min_t(unsigned int, total_mt_num,
+						 cpumask_weight(per_node_cpumask));
+	total_mt_num = min_t(unsigned int, total_mt_num, nr);
+
+	if (total_mt_num > 1 && zswap_compress_wq)
+		work_items = kcalloc(total_mt_num, sizeof(*work_items), GFP_KERNEL);
+
+	if (!work_items) {
+		struct zswap_compress_work my_work = {
+			.type = type,
+			.first = 0,
+			.stride = 1,
+			.nr = nr,
+			.offsets = offsets,
+			.pages = pages,
+			.entries = entries,
+			.rets = rets,
+		};
+
+		zswap_compress_work_thread((struct work_struct *)&my_work);
+		return;
+	}
+
+	i = 0;
+	for_each_cpu(cpu, per_node_cpumask) {
+		if (i >= total_mt_num)
+			break;
+		INIT_WORK((struct work_struct *)&work_items[i],
+				  zswap_compress_work_thread);
+		work_items[i].type = type;
+		work_items[i].first = i;
+		work_items[i].stride = total_mt_num;
+		work_items[i].nr = nr;
+		work_items[i].offsets = offsets;
+		work_items[i].pages = pages;
+		work_items[i].entries = entries;
+		work_items[i].rets = rets;
+
+		queue_work_on(cpu, zswap_compress_wq,
+					  (struct work_struct *)&work_items[i]);
+		++i;
+	}
+
+	/* Wait until it finishes  */
+	while (--i >= 0)
+		flush_work((struct work_struct *)&work_items[i]);
+
+	kfree(work_items);
+}
+
+/*
+ * Store up to FRONTSWAP_BATCH_MAX pages at once: compression is spread over
+ * the node's CPUs and every compressed page is mapped under a single tree
+ * lock. rets[i] receives the result for pages[i].
+ */
+static void zswap_frontswap_store_batch(unsigned type, pgoff_t *offsets,
+				struct page **pages, int nr, int *rets)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entries[FRONTSWAP_BATCH_MAX] = { NULL };
+	int nr_stored = 0;
+	int ret = 0;
+	int i;
+
+	VM_BUG_ON(nr > FRONTSWAP_BATCH_MAX);
+
+	if (!zswap_enabled || !tree)
+		ret = -ENODEV;
+	else
+		ret = zswap_make_room();
+
+	for (i = 0; i < nr; i++) {
+		rets[i] = ret;
+		if (ret)
+			continue;
+
+		/* THP isn't supported */
+		if (PageTransHuge(pages[i])) {
+			rets[i] = -EINVAL;
+			continue;
+		}
+
+		entries[i] = zswap_entry_cache_alloc(GFP_KERNEL);
+		if (!entries[i]) {
+			zswap_reject_kmemcache_fail++;
+			rets[i] = -ENOMEM;
+			continue;
+		}
+
+		/* if entry is successfully added, it keeps the reference */
+		entries[i]->pool = zswap_pool_current_get();
+		if (!entries[i]->pool) {
+			zswap_entry_cache_free(entries[i]);
+			entries[i] = NULL;
+			rets[i] = -EINVAL;
+		}
+	}
+
+	if (ret)
+		return;
+
+	zswap_compress_entries(type, offsets, pages, entries, nr, rets);
+
+	/* map */
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++) {
+		if (!entries[i] || rets[i])
+			continue;
+		zswap_rb_insert_replace(tree, entries[i]);
+		nr_stored++;
+	}
+	spin_unlock(&tree->lock);
+
+	for (i = 0; i < nr; i++) {
+		if (!entries[i] || !rets[i])
+			continue;
+		zswap_pool_put(entries[i]->pool);
+		zswap_entry_cache_free(entries[i]);
+	}
+
+	/* update stats */
+	if (nr_stored) {
+		atomic_add(nr_stored, &zswap_stored_pages);
+		zswap_update_total_size();
+	}
+}
+
 /*
  * returns 0 if the page was successfully decompressed
  * return -1 on entry not found or error
@@ -1183,6 +1389,7 @@ static void zswap_frontswap_init(unsigned type)
 
 static struct frontswap_ops zswap_frontswap_ops = {
 	.store = zswap_frontswap_store,
+	.store_batch = zswap_frontswap_store_batch,
 	.load = zswap_frontswap_load,
 	.invalidate_page = zswap_frontswap_invalidate_page,
 	.invalidate_area = zswap_frontswap_invalidate_area,
@@ -1281,6 +1488,11 @@ static int __init init_zswap(void)
 		zswap_enabled = false;
 	}
 
+	zswap_compress_wq = alloc_workqueue("zswap_compress",
+					    WQ_MEM_RECLAIM | WQ_HIGHPRI, 0);
+	if (!zswap_compress_wq)
+		pr_warn("compression workqueue creation failed\n");
+
 	frontswap_register_ops(&zswap_frontswap_ops);
 	if (zswap_debugfs_init())
 		pr_warn("debugfs initialization failed\n");